@@ -0,0 +1,243 @@
+#ifndef STG_BROADPHASE_H
+#define STG_BROADPHASE_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/*
+    broadphase:
+        uniform grid, hashed so the arena has no fixed bounds
+        every item is a circle (x, y, r) and goes into the one cell holding
+        its center, the cell is at least as big as the largest diameter so
+        a pair can only overlap if their cells are neighbours
+
+        per tick:
+            clear_broadphase()
+            add_broadphase() for every item
+            build_broadphase()  -> counting sort of the items by bucket
+            find_pairs_broadphase() -> bp->pairs, bp->num_pairs
+
+        no linked lists, the items are copied into flat arrays in bucket order
+        so a cell is a contiguous range, every buffer is kept between ticks
+        and only grows, so a tick does no allocations once warmed up
+
+        each cell looks at itself + 4 forward neighbours (half of the 3x3),
+        so every pair is found exactly once
+        items with the same group > 0 never pair (segments of one snake)
+*/
+
+struct bp_pair {
+    int a, b; // item index (add order)
+};
+
+struct broadphase {
+    float cell;         // cell size used by the last build
+    float min_cell;
+
+    // items, add order
+    int num, cap;
+    float * x, * y, * r;
+    int * id;           // caller data
+    int * group;
+    unsigned int * key; // bucket
+
+    // items, bucket order
+    int * sorted;       // -> item index
+    float * sx, * sy, * sr;
+    int * scx, * scy, * sgroup;
+
+    int buckets;        // power of 2
+    int * start;        // [buckets + 1], items of bucket b are start[b] .. start[b + 1]
+
+    int num_pairs, pairs_cap;
+    struct bp_pair * pairs;
+};
+
+void init_broadphase(struct broadphase * bp, float min_cell) {
+    memset(bp, 0, sizeof(struct broadphase));
+    bp->min_cell = min_cell;
+    bp->cell = min_cell;
+}
+
+void free_broadphase(struct broadphase * bp) {
+    free(bp->x); free(bp->y); free(bp->r);
+    free(bp->id); free(bp->group); free(bp->key);
+    free(bp->sorted);
+    free(bp->sx); free(bp->sy); free(bp->sr);
+    free(bp->scx); free(bp->scy); free(bp->sgroup);
+    free(bp->start);
+    free(bp->pairs);
+    memset(bp, 0, sizeof(struct broadphase));
+}
+
+void clear_broadphase(struct broadphase * bp) {
+    bp->num = 0;
+    bp->num_pairs = 0;
+}
+
+static void grow_broadphase(struct broadphase * bp) {
+    bp->cap = bp->cap ? bp->cap * 2 : 256;
+    bp->x = realloc(bp->x, sizeof(float) * bp->cap);
+    bp->y = realloc(bp->y, sizeof(float) * bp->cap);
+    bp->r = realloc(bp->r, sizeof(float) * bp->cap);
+    bp->id = realloc(bp->id, sizeof(int) * bp->cap);
+    bp->group = realloc(bp->group, sizeof(int) * bp->cap);
+    bp->key = realloc(bp->key, sizeof(unsigned int) * bp->cap);
+    bp->sorted = realloc(bp->sorted, sizeof(int) * bp->cap);
+    bp->sx = realloc(bp->sx, sizeof(float) * bp->cap);
+    bp->sy = realloc(bp->sy, sizeof(float) * bp->cap);
+    bp->sr = realloc(bp->sr, sizeof(float) * bp->cap);
+    bp->scx = realloc(bp->scx, sizeof(int) * bp->cap);
+    bp->scy = realloc(bp->scy, sizeof(int) * bp->cap);
+    bp->sgroup = realloc(bp->sgroup, sizeof(int) * bp->cap);
+}
+
+// returns the item index, pairs refer to items by it
+int add_broadphase(struct broadphase * bp, float x, float y, float r, int id, int group) {
+    if(bp->num == bp->cap) grow_broadphase(bp);
+    int i = bp->num++;
+    bp->x[i] = x;
+    bp->y[i] = y;
+    bp->r[i] = r;
+    bp->id[i] = id;
+    bp->group[i] = group;
+    return i;
+}
+
+static inline unsigned int hash_cell_broadphase(int cx, int cy, int buckets) {
+    return ((unsigned int)cx * 73856093u ^ (unsigned int)cy * 19349663u) & (unsigned int)(buckets - 1);
+}
+
+static inline int cell_coord_broadphase(float v, float inv_cell) {
+    return (int)floorf(v * inv_cell);
+}
+
+void build_broadphase(struct broadphase * bp) {
+    int n = bp->num;
+
+    // cell >= largest diameter
+    float max_r = 0.0f;
+    for(int i = 0; i < n; i++) {
+        if(bp->r[i] > max_r) max_r = bp->r[i];
+    }
+    bp->cell = 2.0f * max_r > bp->min_cell ? 2.0f * max_r : bp->min_cell;
+    float inv_cell = 1.0f / bp->cell;
+
+    // ~2 buckets per item keeps hash collisions rare
+    int buckets = 64;
+    while(buckets < 2 * n) buckets <<= 1;
+    if(buckets > bp->buckets) {
+        bp->buckets = buckets;
+        bp->start = realloc(bp->start, sizeof(int) * (buckets + 1));
+    }
+    buckets = bp->buckets;
+
+    // counting sort: count, exclusive prefix sum, scatter
+    memset(bp->start, 0, sizeof(int) * (buckets + 1));
+    for(int i = 0; i < n; i++) {
+        unsigned int k = hash_cell_broadphase(cell_coord_broadphase(bp->x[i], inv_cell),
+                                              cell_coord_broadphase(bp->y[i], inv_cell), buckets);
+        bp->key[i] = k;
+        bp->start[k + 1]++;
+    }
+    for(int b = 0; b < buckets; b++) {
+        bp->start[b + 1] += bp->start[b];
+    }
+
+    // start[b] is used as the write cursor and ends up at start[b + 1], shifted back after
+    for(int i = 0; i < n; i++) {
+        int p = bp->start[bp->key[i]]++;
+        bp->sorted[p] = i;
+        bp->sx[p] = bp->x[i];
+        bp->sy[p] = bp->y[i];
+        bp->sr[p] = bp->r[i];
+        bp->scx[p] = cell_coord_broadphase(bp->x[i], inv_cell);
+        bp->scy[p] = cell_coord_broadphase(bp->y[i], inv_cell);
+        bp->sgroup[p] = bp->group[i];
+    }
+    for(int b = buckets; b > 0; b--) {
+        bp->start[b] = bp->start[b - 1];
+    }
+    bp->start[0] = 0;
+}
+
+static inline void push_pair_broadphase(struct broadphase * bp, int a, int b) {
+    if(bp->num_pairs == bp->pairs_cap) {
+        bp->pairs_cap = bp->pairs_cap ? bp->pairs_cap * 2 : 1024;
+        bp->pairs = realloc(bp->pairs, sizeof(struct bp_pair) * bp->pairs_cap);
+    }
+    bp->pairs[bp->num_pairs].a = a;
+    bp->pairs[bp->num_pairs].b = b;
+    bp->num_pairs++;
+}
+
+// candidate pairs = bounding boxes overlap, returns the pair count
+int find_pairs_broadphase(struct broadphase * bp) {
+    // own cell + forward half of the neighbours
+    static const int offsets[5][2] = { { 0, 0 }, { 1, 0 }, { -1, 1 }, { 0, 1 }, { 1, 1 } };
+
+    bp->num_pairs = 0;
+
+    for(int p = 0; p < bp->num; p++) {
+        float px = bp->sx[p], py = bp->sy[p], pr = bp->sr[p];
+        int pg = bp->sgroup[p];
+
+        for(int o = 0; o < 5; o++) {
+            int cx = bp->scx[p] + offsets[o][0];
+            int cy = bp->scy[p] + offsets[o][1];
+            unsigned int b = hash_cell_broadphase(cx, cy, bp->buckets);
+            int q = o == 0 ? p + 1 : bp->start[b];
+            int end = bp->start[b + 1];
+
+            for(; q < end; q++) {
+                // other cells can share the bucket
+                if(bp->scx[q] != cx || bp->scy[q] != cy) continue;
+                if(pg > 0 && bp->sgroup[q] == pg) continue;
+
+                float rr = pr + bp->sr[q];
+                if(fabsf(bp->sx[q] - px) < rr && fabsf(bp->sy[q] - py) < rr) {
+                    push_pair_broadphase(bp, bp->sorted[p], bp->sorted[q]);
+                }
+            }
+        }
+    }
+
+    return bp->num_pairs;
+}
+
+/*
+    items whose bounding box overlaps the circle (x, y, r), for things that are
+    not in the grid themselves (swept shapes, projectiles)
+    r can be bigger than a cell, every covered cell is visited
+    writes up to max item indices to out, returns how many were found
+*/
+int query_broadphase(struct broadphase * bp, float x, float y, float r, int * out, int max) {
+    float inv_cell = 1.0f / bp->cell;
+    int found = 0;
+
+    if(bp->num == 0) return 0;
+
+    // items stick out of their cell by up to half a cell
+    float reach = r + 0.5f * bp->cell;
+    int x0 = cell_coord_broadphase(x - reach, inv_cell), x1 = cell_coord_broadphase(x + reach, inv_cell);
+    int y0 = cell_coord_broadphase(y - reach, inv_cell), y1 = cell_coord_broadphase(y + reach, inv_cell);
+
+    for(int cy = y0; cy <= y1; cy++) {
+        for(int cx = x0; cx <= x1; cx++) {
+            unsigned int b = hash_cell_broadphase(cx, cy, bp->buckets);
+            for(int q = bp->start[b]; q < bp->start[b + 1]; q++) {
+                if(bp->scx[q] != cx || bp->scy[q] != cy) continue;
+
+                float rr = r + bp->sr[q];
+                if(fabsf(bp->sx[q] - x) < rr && fabsf(bp->sy[q] - y) < rr) {
+                    if(found == max) return found;
+                    out[found++] = bp->sorted[q];
+                }
+            }
+        }
+    }
+    return found;
+}
+
+#endif /* STG_BROADPHASE_H */
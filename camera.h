@@ -0,0 +1,123 @@
+#ifndef STG_CAMERA_H
+#define STG_CAMERA_H
+
+#include <stdio.h>
+#include <string.h>
+
+#include <GL/glew.h>
+
+#include "mat4.h"
+#include "glstate.h"
+
+/*
+    camera:
+        view, proj and vp are only rebuilt when something changed (dirty) and
+        live in a uniform buffer bound to CAMERA_UBO_BINDING, every program
+        that declares CAMERA_BLOCK_SRC reads them from there, so a frame does
+        no matrix work and no uniform calls for the camera at all
+        no ubo support -> ubo stays 0 and the caller sets m.vp as a uniform
+
+    std140: a mat4 is 4 vec4 columns, column major like mat4 here, three of
+    them back to back have no padding -> struct camera_block is uploaded as is
+*/
+
+#define CAMERA_UBO_BINDING  0
+#define OBJECT_UBO_BINDING  1
+
+#define CAMERA_BLOCK_SRC \
+    "layout(std140) uniform camera {\n" \
+    "\tmat4 view;\n" \
+    "\tmat4 proj;\n" \
+    "\tmat4 vp;\n" \
+    "};\n"
+
+struct camera_block {
+    mat4 view;
+    mat4 proj;
+    mat4 vp;
+};
+
+struct camera {
+    float fov;          // radians
+    float aspect, z_near, z_far;
+    vec3 eye, dir, up;
+    int dirty;
+
+    struct camera_block m;
+    GLuint ubo;
+
+    // stats
+    unsigned long long int rebuilds;
+};
+
+int has_uniform_buffers(void) {
+    return GLEW_VERSION_3_1 || GLEW_ARB_uniform_buffer_object;
+}
+
+void init_camera(struct camera * c, float fov, float aspect, float z_near, float z_far, int use_ubo) {
+    memset(c, 0, sizeof(struct camera));
+    c->fov = fov;
+    c->aspect = aspect;
+    c->z_near = z_near;
+    c->z_far = z_far;
+    set_vec3(0, 0, 1, &c->eye);
+    set_vec3(0, 0, -1, &c->dir);
+    set_vec3(0, 1, 0, &c->up);
+    c->dirty = 1;
+
+    if(use_ubo) {
+        glGenBuffers(1, &c->ubo);
+        gls_bind_buffer(GL_UNIFORM_BUFFER, c->ubo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(struct camera_block), NULL, GL_DYNAMIC_DRAW);
+        gls_bind_buffer_base(GL_UNIFORM_BUFFER, CAMERA_UBO_BINDING, c->ubo);
+    }
+}
+
+void free_camera(struct camera * c) {
+    if(c->ubo) glDeleteBuffers(1, &c->ubo);
+    c->ubo = 0;
+}
+
+void set_camera_aspect(struct camera * c, float aspect) {
+    if(aspect == c->aspect) return;
+    c->aspect = aspect;
+    c->dirty = 1;
+}
+
+void set_camera_lookat(struct camera * c, vec3 eye, vec3 dir, vec3 up) {
+    if(!memcmp(&eye, &c->eye, sizeof(vec3)) && !memcmp(&dir, &c->dir, sizeof(vec3)) &&
+       !memcmp(&up, &c->up, sizeof(vec3))) return;
+    c->eye = eye;
+    c->dir = dir;
+    c->up = up;
+    c->dirty = 1;
+}
+
+// once per frame, only does work after a change
+void update_camera(struct camera * c) {
+    if(!c->dirty) return;
+
+    identity_mat4(&c->m.proj);
+    identity_mat4(&c->m.view);
+    perspective_mat4(c->fov, c->aspect, c->z_near, c->z_far, &c->m.proj);
+    lookat_mat4(c->eye, c->dir, c->up, &c->m.view);
+    mul_mat4(&c->m.proj, &c->m.view, &c->m.vp);
+
+    if(c->ubo) {
+        gls_bind_buffer(GL_UNIFORM_BUFFER, c->ubo);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(struct camera_block), &c->m);
+    }
+    c->rebuilds++;
+    c->dirty = 0;
+}
+
+// points the program's blocks at the shared bindings, after linking
+void bind_uniform_blocks(GLuint program) {
+    GLuint index = glGetUniformBlockIndex(program, "camera");
+    if(index != GL_INVALID_INDEX) glUniformBlockBinding(program, index, CAMERA_UBO_BINDING);
+
+    index = glGetUniformBlockIndex(program, "objects");
+    if(index != GL_INVALID_INDEX) glUniformBlockBinding(program, index, OBJECT_UBO_BINDING);
+}
+
+#endif /* STG_CAMERA_H */
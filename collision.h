@@ -0,0 +1,460 @@
+#ifndef STG_COLLISION_H
+#define STG_COLLISION_H
+
+#include <math.h>
+
+#include "mat4.h"
+#include "sim.h"
+#include "snakes.h"
+#include "broadphase.h"
+
+/*
+    collision:
+        broadphase.h finds the candidate pairs, this does the narrowphase
+        and pushes overlapping shapes apart (position only, verlet picks
+        the change up as velocity on the next tick)
+
+        snake segment vs snake segment  -> circle / circle, both move half
+        player vs snake segment         -> triangle / circle, the player moves
+
+    swept:
+        sweep_* return the time of impact as a fraction of the move (0..1),
+        -1 for no hit, 0 if already touching and moving closer
+        only fast things are swept (spears, the player), and only the ones
+        that hit something get sub-stepped: move to the toi, respond, then
+        sweep the rest of the move again
+*/
+
+// bounding circle of the player triangle (farthest corner)
+#define PLAYER_RADIUS   (0.7072f * PLAYER_SCALE)
+
+// broadphase id of the player, snake segments use their array index (>= 0)
+#define COLLIDE_PLAYER_ID   (-1)
+
+// sub-steps per spear per tick, a spear stuck between two segments gives up after this
+#define SPEAR_MAX_HITS      4
+
+struct collide_stats {
+    unsigned long long int ticks;
+    unsigned long long int items;
+    unsigned long long int pairs;       // broadphase candidates
+    unsigned long long int contacts;    // actual overlaps
+    unsigned long long int swept_hits;  // toi < 1, caused a sub-step
+};
+
+// closest point on triangle abc to p (2d, xy)
+void closest_point_triangle(float px, float py, vec3 * a, vec3 * b, vec3 * c, float * qx, float * qy) {
+    float abx = b->x - a->x, aby = b->y - a->y;
+    float acx = c->x - a->x, acy = c->y - a->y;
+    float apx = px - a->x, apy = py - a->y;
+
+    float d1 = abx * apx + aby * apy;
+    float d2 = acx * apx + acy * apy;
+    if(d1 <= 0.0f && d2 <= 0.0f) { *qx = a->x; *qy = a->y; return; }
+
+    float bpx = px - b->x, bpy = py - b->y;
+    float d3 = abx * bpx + aby * bpy;
+    float d4 = acx * bpx + acy * bpy;
+    if(d3 >= 0.0f && d4 <= d3) { *qx = b->x; *qy = b->y; return; }
+
+    float vc = d1 * d4 - d3 * d2;
+    if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        float v = d1 / (d1 - d3);
+        *qx = a->x + abx * v; *qy = a->y + aby * v;
+        return;
+    }
+
+    float cpx = px - c->x, cpy = py - c->y;
+    float d5 = abx * cpx + aby * cpy;
+    float d6 = acx * cpx + acy * cpy;
+    if(d6 >= 0.0f && d5 <= d6) { *qx = c->x; *qy = c->y; return; }
+
+    float vb = d5 * d2 - d1 * d6;
+    if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        float w = d2 / (d2 - d6);
+        *qx = a->x + acx * w; *qy = a->y + acy * w;
+        return;
+    }
+
+    float va = d3 * d6 - d5 * d4;
+    if(va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+        float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        *qx = b->x + (c->x - b->x) * w; *qy = b->y + (c->y - b->y) * w;
+        return;
+    }
+
+    // inside
+    *qx = px;
+    *qy = py;
+}
+
+/*
+    circle a moving by (adx, ady) vs circle b moving by (bdx, bdy)
+    solves |p + m t| = ra + rb with p = a - b, m = relative motion
+*/
+float sweep_circle_circle(float ax, float ay, float adx, float ady, float ar,
+                          float bx, float by, float bdx, float bdy, float br) {
+    float px = ax - bx, py = ay - by;
+    float mx = adx - bdx, my = ady - bdy;
+    float rr = ar + br;
+
+    float a = mx * mx + my * my;
+    float b = px * mx + py * my;
+    float c = px * px + py * py - rr * rr;
+
+    if(c < 0.0f) return b < 0.0f ? 0.0f : -1.0f; // overlapping
+    if(b >= 0.0f || a < 1e-12f) return -1.0f;    // moving apart / not moving
+
+    float disc = b * b - a * c;
+    if(disc < 0.0f) return -1.0f;
+
+    float t = (-b - sqrtf(disc)) / a;
+    return t <= 1.0f ? t : -1.0f;
+}
+
+// ray o + d * t vs segment ab, t in 0..1 or -1
+float ray_segment(float ox, float oy, float dx, float dy, float ax, float ay, float bx, float by) {
+    float ex = bx - ax, ey = by - ay;
+    float den = dx * ey - dy * ex;
+    if(fabsf(den) < 1e-12f) return -1.0f; // parallel
+
+    float wx = ax - ox, wy = ay - oy;
+    float t = (wx * ey - wy * ex) / den;
+    float u = (wx * dy - wy * dx) / den;
+    if(t < 0.0f || t > 1.0f || u < 0.0f || u > 1.0f) return -1.0f;
+    return t;
+}
+
+// circle c (radius r) moving by d vs static segment ab -> ray vs the capsule around ab
+float sweep_circle_segment(float cx, float cy, float dx, float dy, float r,
+                           float ax, float ay, float bx, float by) {
+    float best = -1.0f;
+    float t;
+
+    // sides: ray vs ab pushed out by r towards the circle
+    float ex = bx - ax, ey = by - ay;
+    float len = sqrtf(ex * ex + ey * ey);
+    if(len > 1e-6f) {
+        float nx = -ey / len, ny = ex / len;
+        if((cx - ax) * nx + (cy - ay) * ny < 0.0f) { nx = -nx; ny = -ny; }
+        // only when moving towards the side
+        if(dx * nx + dy * ny < 0.0f) {
+            t = ray_segment(cx, cy, dx, dy, ax + nx * r, ay + ny * r, bx + nx * r, by + ny * r);
+            if(t >= 0.0f) best = t;
+        }
+    }
+
+    // caps
+    t = sweep_circle_circle(cx, cy, dx, dy, r, ax, ay, 0.0f, 0.0f, 0.0f);
+    if(t >= 0.0f && (best < 0.0f || t < best)) best = t;
+    t = sweep_circle_circle(cx, cy, dx, dy, r, bx, by, 0.0f, 0.0f, 0.0f);
+    if(t >= 0.0f && (best < 0.0f || t < best)) best = t;
+
+    return best;
+}
+
+/*
+    triangle moving by d vs static circle c
+    same as the circle moving by -d against the static triangle
+*/
+float sweep_triangle_circle(vec3 tri[3], float dx, float dy, float cx, float cy, float r) {
+    float qx, qy;
+
+    closest_point_triangle(cx, cy, &tri[0], &tri[1], &tri[2], &qx, &qy);
+    float ox = qx - cx, oy = qy - cy;
+    if(ox * ox + oy * oy < r * r) {
+        // already touching, counts if the triangle moves into the circle
+        return (dx * -ox + dy * -oy) < 0.0f ? 0.0f : -1.0f;
+    }
+
+    float best = -1.0f;
+    for(int i = 0; i < 3; i++) {
+        vec3 * a = &tri[i];
+        vec3 * b = &tri[(i + 1) % 3];
+        float t = sweep_circle_segment(cx, cy, -dx, -dy, r, a->x, a->y, b->x, b->y);
+        if(t >= 0.0f && (best < 0.0f || t < best)) best = t;
+    }
+    return best;
+}
+
+/*
+    segment from o moving by d (a point, or the tip of a spear) vs a polyline
+    of n points, xy pairs, closed -> last point connects back to the first
+    returns the toi, *hit = index of the hit line (from pts[hit] to the next)
+*/
+float sweep_point_polyline(float ox, float oy, float dx, float dy,
+                           const float * pts, int n, int closed, int * hit) {
+    float best = -1.0f;
+    int lines = closed ? n : n - 1;
+
+    for(int i = 0; i < lines; i++) {
+        int j = (i + 1) % n;
+        float t = ray_segment(ox, oy, dx, dy, pts[i * 2], pts[i * 2 + 1], pts[j * 2], pts[j * 2 + 1]);
+        if(t >= 0.0f && (best < 0.0f || t < best)) {
+            best = t;
+            if(hit) *hit = i;
+        }
+    }
+    return best;
+}
+
+// circles a / b overlap -> move them apart, wa + wb = 1, returns 1 on contact
+static inline int resolve_circles(float * ax, float * ay, float ar, float * bx, float * by, float br,
+                                    float wa, float wb) {
+    float dx = *bx - *ax;
+    float dy = *by - *ay;
+    float rr = ar + br;
+    float d2 = dx * dx + dy * dy;
+    if(d2 >= rr * rr) return 0;
+
+    float d = sqrtf(d2);
+    if(d < 1e-6f) { dx = 1.0f; dy = 0.0f; d = 1.0f; } // same spot, any direction works
+    float k = (rr - d) / d;
+    *ax -= dx * k * wa;
+    *ay -= dy * k * wa;
+    *bx += dx * k * wb;
+    *by += dy * k * wb;
+    return 1;
+}
+
+// circle vs the player triangle, pushes the player out, returns 1 on contact
+int resolve_player_circle(struct player_s * p, float cx, float cy, float cr) {
+    vec3 tri[3];
+    float qx, qy;
+
+    get_player_triangle(p, tri);
+    closest_point_triangle(cx, cy, &tri[0], &tri[1], &tri[2], &qx, &qy);
+
+    float dx = qx - cx;
+    float dy = qy - cy;
+    float d = sqrtf(dx * dx + dy * dy);
+    if(d >= cr) return 0;
+
+    float nx, ny, depth;
+    if(d > 1e-6f) {
+        // closest point is on the outline
+        nx = dx / d; ny = dy / d;
+        depth = cr - d;
+    } else {
+        // circle center inside the triangle, push along center -> player
+        nx = p->pos.x - cx; ny = p->pos.y - cy;
+        float l = sqrtf(nx * nx + ny * ny);
+        if(l < 1e-6f) { nx = 1.0f; ny = 0.0f; l = 1.0f; }
+        nx /= l; ny /= l;
+        depth = cr + PLAYER_RADIUS;
+    }
+
+    p->pos.x += nx * depth;
+    p->pos.y += ny * depth;
+
+    // drop the velocity going into the circle
+    float vn = p->vel.x * nx + p->vel.y * ny;
+    if(vn < 0.0f) {
+        p->vel.x -= nx * vn;
+        p->vel.y -= ny * vn;
+    }
+    return 1;
+}
+
+#define COLLIDE_MAX_QUERY   256
+
+// reflect v off a surface with normal n (pointing away from it), e = restitution
+static inline void bounce_vec3(vec3 * v, float nx, float ny, float e) {
+    float vn = v->x * nx + v->y * ny;
+    if(vn < 0.0f) {
+        v->x -= (1.0f + e) * vn * nx;
+        v->y -= (1.0f + e) * vn * ny;
+    }
+}
+
+/*
+    player swept from prev to its current position against the snakes
+    on a hit the player is put back to the toi and the inward velocity dropped
+    the grid has to be built already, returns 1 on a hit
+*/
+static int sweep_player(struct broadphase * bp, struct snakes * s, struct player_s * p, vec3 * prev) {
+    int found[COLLIDE_MAX_QUERY];
+    struct player_s at_prev = *p;
+    vec3 tri[3];
+
+    float mx = p->pos.x - prev->x;
+    float my = p->pos.y - prev->y;
+    float len = sqrtf(mx * mx + my * my);
+    if(len < 1e-6f) return 0;
+
+    at_prev.pos = *prev;
+    get_player_triangle(&at_prev, tri);
+
+    int n = query_broadphase(bp, prev->x + mx * 0.5f, prev->y + my * 0.5f, PLAYER_RADIUS + len * 0.5f,
+                                found, COLLIDE_MAX_QUERY);
+    float best = -1.0f;
+    int best_k = -1;
+    float best_r = 0.0f;
+    for(int i = 0; i < n; i++) {
+        int k = bp->id[found[i]];
+        if(k == COLLIDE_PLAYER_ID) continue;
+
+        float t = sweep_triangle_circle(tri, mx, my, s->x[k], s->y[k], bp->r[found[i]]);
+        if(t >= 0.0f && (best < 0.0f || t < best)) {
+            best = t;
+            best_k = k;
+            best_r = bp->r[found[i]];
+        }
+    }
+    if(best < 0.0f) return 0;
+
+    p->pos.x = prev->x + mx * best;
+    p->pos.y = prev->y + my * best;
+    // touching now, a hair more radius makes the resolver see it and clip the velocity
+    resolve_player_circle(p, s->x[best_k], s->y[best_k], best_r + 1e-4f);
+    return 1;
+}
+
+/*
+    one collision pass over the whole scene, run after the sim + snake tick
+    player_prev = player position before the tick (for the sweep), or NULL
+*/
+void collide_scene(struct broadphase * bp, struct snakes * s, struct sim_state * sim, vec3 * player_prev,
+                    struct collide_stats * stats) {
+    struct player_s * p = &sim->player;
+    int contacts = 0;
+    int swept = 0;
+
+    clear_broadphase(bp);
+    for(int j = 0; j < s->segments; j++) {
+        float r = 0.5f * snake_segment_scale(s, j);
+        for(int i = 0; i < s->count; i++) {
+            int k = j * s->stride + i;
+            add_broadphase(bp, s->x[k], s->y[k], r, k, i + 1);
+        }
+    }
+    add_broadphase(bp, p->pos.x, p->pos.y, PLAYER_RADIUS, COLLIDE_PLAYER_ID, 0);
+
+    build_broadphase(bp);
+
+    // fast enough to skip over a tail segment in one tick
+    if(player_prev) swept += sweep_player(bp, s, p, player_prev);
+
+    find_pairs_broadphase(bp);
+
+    for(int n = 0; n < bp->num_pairs; n++) {
+        int a = bp->pairs[n].a;
+        int b = bp->pairs[n].b;
+        int ida = bp->id[a];
+        int idb = bp->id[b];
+
+        if(ida == COLLIDE_PLAYER_ID || idb == COLLIDE_PLAYER_ID) {
+            int k = ida == COLLIDE_PLAYER_ID ? idb : ida;
+            float r = ida == COLLIDE_PLAYER_ID ? bp->r[b] : bp->r[a];
+            contacts += resolve_player_circle(p, s->x[k], s->y[k], r);
+        } else {
+            contacts += resolve_circles(&s->x[ida], &s->y[ida], bp->r[a],
+                                        &s->x[idb], &s->y[idb], bp->r[b], 0.5f, 0.5f);
+        }
+    }
+
+    if(stats) {
+        stats->ticks++;
+        stats->items += bp->num;
+        stats->pairs += bp->num_pairs;
+        stats->contacts += contacts;
+        stats->swept_hits += swept;
+    }
+}
+
+#define SPEAR_RESTITUTION   0.6f
+#define SPEAR_KNOCK         0.08f   // how far a hit segment gets shoved
+
+/*
+    moves every live spear by vel * dt, swept against the snakes and the arena
+    walls, a spear that hits something is moved to the toi, bounces, and the
+    rest of its move is swept again (up to SPEAR_MAX_HITS times)
+    uses the grid from collide_scene(), run right after it
+*/
+void step_spears(struct broadphase * bp, struct snakes * s, struct sim_state * sim, float dt,
+                    struct collide_stats * stats) {
+    static const float arena[8] = {
+        -ARENA_HALF_W, -ARENA_HALF_H,
+         ARENA_HALF_W, -ARENA_HALF_H,
+         ARENA_HALF_W,  ARENA_HALF_H,
+        -ARENA_HALF_W,  ARENA_HALF_H,
+    };
+    int found[COLLIDE_MAX_QUERY];
+
+    for(int i = 0; i < MAX_SPEARS; i++) {
+        struct spear_s * sp = &sim->spears[i];
+        if(sp->life <= 0.0f) continue;
+
+        float left = 1.0f; // fraction of this tick's move still to do
+        // after SPEAR_MAX_HITS the spear is wedged and the rest of the move is dropped
+        for(int hits = 0; hits < SPEAR_MAX_HITS; hits++) {
+            float mx = sp->vel.x * dt * left;
+            float my = sp->vel.y * dt * left;
+            float len = sqrtf(mx * mx + my * my);
+
+            // snakes, segments were nudged by the resolve after the build -> small margin
+            int n = query_broadphase(bp, sp->pos.x + mx * 0.5f, sp->pos.y + my * 0.5f,
+                                        SPEAR_RADIUS + len * 0.5f + 0.1f, found, COLLIDE_MAX_QUERY);
+            float best = -1.0f;
+            int best_k = -1, wall = 0;
+            for(int q = 0; q < n; q++) {
+                int k = bp->id[found[q]];
+                if(k == COLLIDE_PLAYER_ID) continue;
+
+                float t = sweep_circle_circle(sp->pos.x, sp->pos.y, mx, my, SPEAR_RADIUS,
+                                                s->x[k], s->y[k], 0.0f, 0.0f, bp->r[found[q]]);
+                if(t >= 0.0f && (best < 0.0f || t < best)) {
+                    best = t;
+                    best_k = k;
+                }
+            }
+
+            // arena walls, only from the inside (ccw polygon -> left normal points inside)
+            float wnx = 0.0f, wny = 0.0f;
+            float tw = sweep_point_polyline(sp->pos.x, sp->pos.y, mx, my, arena, 4, 1, &wall);
+            if(tw >= 0.0f) {
+                int j = (wall + 1) % 4;
+                float ex = arena[j * 2] - arena[wall * 2];
+                float ey = arena[j * 2 + 1] - arena[wall * 2 + 1];
+                float l = sqrtf(ex * ex + ey * ey);
+                wnx = -ey / l;
+                wny = ex / l;
+                if(mx * wnx + my * wny >= 0.0f) tw = -1.0f;
+            }
+            if(tw >= 0.0f && (best < 0.0f || tw < best)) {
+                best = tw;
+                best_k = -1;
+            }
+
+            if(best < 0.0f) {
+                // free flight, the common case, no sub-step
+                sp->pos.x += mx;
+                sp->pos.y += my;
+                break;
+            }
+
+            sp->pos.x += mx * best;
+            sp->pos.y += my * best;
+            left *= 1.0f - best;
+
+            float nx, ny;
+            if(best_k >= 0) {
+                nx = sp->pos.x - s->x[best_k];
+                ny = sp->pos.y - s->y[best_k];
+                float l = sqrtf(nx * nx + ny * ny);
+                if(l < 1e-6f) { nx = -sp->vel.x; ny = -sp->vel.y; l = sqrtf(nx * nx + ny * ny) + 1e-6f; }
+                nx /= l; ny /= l;
+
+                s->x[best_k] -= nx * SPEAR_KNOCK;
+                s->y[best_k] -= ny * SPEAR_KNOCK;
+            } else {
+                nx = wnx;
+                ny = wny;
+            }
+            bounce_vec3(&sp->vel, nx, ny, SPEAR_RESTITUTION);
+            if(stats) stats->swept_hits++;
+        }
+    }
+}
+
+#endif /* STG_COLLISION_H */
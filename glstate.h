@@ -0,0 +1,308 @@
+#ifndef STG_GLSTATE_H
+#define STG_GLSTATE_H
+
+#include <stdio.h>
+#include <string.h>
+
+#include <GL/glew.h>
+
+/*
+    gl state tracker:
+        thin cache in front of the gl calls that set state, a call that would
+        not change anything is skipped and counted as elided
+        one context -> one global copy, like the gl state itself
+
+        covered: program, vao, array / uniform buffer, 2d texture (unit 0),
+        read / draw framebuffer, blend / depth / cull / scissor enables and
+        funcs, viewport, clear color and uniform values per program + location
+        everything that binds or changes one of these has to go through gls_*,
+        a raw gl call behind its back makes the cache lie -> gls_reset()
+
+        draws go through gls_draw_*() so they are counted in the same place
+*/
+
+#define GLS_UNKNOWN         0xffffffffu
+#define GLS_UNIFORM_SLOTS   256     // power of 2
+#define GLS_UNIFORM_FLOATS  16
+
+enum gls_buffer {
+    GLS_ARRAY_BUFFER = 0,
+    GLS_UNIFORM_BUFFER,
+
+    GLS_BUFFER_MAX
+};
+
+enum gls_cap {
+    GLS_BLEND = 0,
+    GLS_DEPTH_TEST,
+    GLS_CULL_FACE,
+    GLS_SCISSOR_TEST,
+
+    GLS_CAP_MAX
+};
+
+struct gls_uniform {
+    GLuint program;     // 0 -> empty slot
+    GLint loc;
+    int n;
+    float v[GLS_UNIFORM_FLOATS];
+};
+
+struct gl_state {
+    GLuint program, vao;
+    GLuint buffers[GLS_BUFFER_MAX];
+    GLuint texture_2d;
+    GLuint read_fbo, draw_fbo;
+    unsigned int caps[GLS_CAP_MAX];     // 0 / 1 / GLS_UNKNOWN
+    GLenum blend_src, blend_dst, depth_func, cull_face;
+    GLuint depth_mask;
+    GLint viewport[4];
+    float clear_color[4];
+    int viewport_known, clear_color_known;
+
+    struct gls_uniform uniforms[GLS_UNIFORM_SLOTS];
+
+    // stats
+    unsigned long long int changes;     // state calls that reached gl
+    unsigned long long int uniform_changes;
+    unsigned long long int elided;      // state + uniform calls that were skipped
+    unsigned long long int draws;
+};
+
+static struct gl_state gls;
+
+// forget everything, the next call of each kind goes to gl, stats are kept
+void gls_reset(void) {
+    gls.program = gls.vao = GLS_UNKNOWN;
+    for(int i = 0; i < GLS_BUFFER_MAX; i++) gls.buffers[i] = GLS_UNKNOWN;
+    gls.texture_2d = GLS_UNKNOWN;
+    gls.read_fbo = gls.draw_fbo = GLS_UNKNOWN;
+    for(int i = 0; i < GLS_CAP_MAX; i++) gls.caps[i] = GLS_UNKNOWN;
+    gls.blend_src = gls.blend_dst = gls.depth_func = gls.cull_face = GLS_UNKNOWN;
+    gls.depth_mask = GLS_UNKNOWN;
+    gls.viewport_known = 0;
+    gls.clear_color_known = 0;
+    memset(gls.uniforms, 0, sizeof(gls.uniforms));
+}
+
+// 1 -> value differs from the cached one, the caller makes the gl call
+static inline int gls_set(GLuint * cached, GLuint value) {
+    if(*cached == value) {
+        gls.elided++;
+        return 0;
+    }
+    *cached = value;
+    gls.changes++;
+    return 1;
+}
+
+void gls_use_program(GLuint program) {
+    if(gls_set(&gls.program, program)) glUseProgram(program);
+}
+
+void gls_bind_vertex_array(GLuint vao) {
+    if(gls_set(&gls.vao, vao)) glBindVertexArray(vao);
+}
+
+static inline int gls_buffer_index(GLenum target) {
+    switch(target) {
+        case GL_ARRAY_BUFFER: return GLS_ARRAY_BUFFER;
+        case GL_UNIFORM_BUFFER: return GLS_UNIFORM_BUFFER;
+    }
+    return -1; // element array is vao state, not cached
+}
+
+void gls_bind_buffer(GLenum target, GLuint buffer) {
+    int i = gls_buffer_index(target);
+    if(i < 0) {
+        gls.changes++;
+        glBindBuffer(target, buffer);
+    } else if(gls_set(&gls.buffers[i], buffer)) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+// always goes to gl (indexed binding), the generic binding changes with it
+void gls_bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+    int i = gls_buffer_index(target);
+    if(i >= 0) gls.buffers[i] = buffer;
+    gls.changes++;
+    glBindBufferRange(target, index, buffer, offset, size);
+}
+
+void gls_bind_buffer_base(GLenum target, GLuint index, GLuint buffer) {
+    int i = gls_buffer_index(target);
+    if(i >= 0) gls.buffers[i] = buffer;
+    gls.changes++;
+    glBindBufferBase(target, index, buffer);
+}
+
+void gls_bind_texture_2d(GLuint texture) {
+    if(gls_set(&gls.texture_2d, texture)) glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+void gls_bind_framebuffer(GLenum target, GLuint fbo) {
+    if(target == GL_FRAMEBUFFER) {
+        if(gls.read_fbo == fbo && gls.draw_fbo == fbo) {
+            gls.elided++;
+            return;
+        }
+        gls.read_fbo = gls.draw_fbo = fbo;
+        gls.changes++;
+        glBindFramebuffer(target, fbo);
+    } else if(target == GL_READ_FRAMEBUFFER) {
+        if(gls_set(&gls.read_fbo, fbo)) glBindFramebuffer(target, fbo);
+    } else {
+        if(gls_set(&gls.draw_fbo, fbo)) glBindFramebuffer(target, fbo);
+    }
+}
+
+static inline int gls_cap_index(GLenum cap) {
+    switch(cap) {
+        case GL_BLEND: return GLS_BLEND;
+        case GL_DEPTH_TEST: return GLS_DEPTH_TEST;
+        case GL_CULL_FACE: return GLS_CULL_FACE;
+        case GL_SCISSOR_TEST: return GLS_SCISSOR_TEST;
+    }
+    return -1;
+}
+
+void gls_set_cap(GLenum cap, int on) {
+    int i = gls_cap_index(cap);
+    if(i >= 0 && !gls_set(&gls.caps[i], on ? 1 : 0)) return;
+    if(i < 0) gls.changes++;
+    if(on) glEnable(cap);
+    else glDisable(cap);
+}
+
+void gls_blend_func(GLenum src, GLenum dst) {
+    if(gls.blend_src == src && gls.blend_dst == dst) {
+        gls.elided++;
+        return;
+    }
+    gls.blend_src = src;
+    gls.blend_dst = dst;
+    gls.changes++;
+    glBlendFunc(src, dst);
+}
+
+void gls_depth_func(GLenum func) {
+    if(gls_set(&gls.depth_func, func)) glDepthFunc(func);
+}
+
+// depth writes, glClear() of the depth buffer needs them on
+void gls_depth_mask(int on) {
+    if(gls_set(&gls.depth_mask, on ? 1 : 0)) glDepthMask(on ? GL_TRUE : GL_FALSE);
+}
+
+void gls_cull_face(GLenum mode) {
+    if(gls_set(&gls.cull_face, mode)) glCullFace(mode);
+}
+
+void gls_viewport(GLint x, GLint y, GLint w, GLint h) {
+    GLint v[4] = { x, y, w, h };
+    if(gls.viewport_known && !memcmp(v, gls.viewport, sizeof(v))) {
+        gls.elided++;
+        return;
+    }
+    memcpy(gls.viewport, v, sizeof(v));
+    gls.viewport_known = 1;
+    gls.changes++;
+    glViewport(x, y, w, h);
+}
+
+void gls_clear_color(float r, float g, float b, float a) {
+    float c[4] = { r, g, b, a };
+    if(gls.clear_color_known && !memcmp(c, gls.clear_color, sizeof(c))) {
+        gls.elided++;
+        return;
+    }
+    memcpy(gls.clear_color, c, sizeof(c));
+    gls.clear_color_known = 1;
+    gls.changes++;
+    glClearColor(r, g, b, a);
+}
+
+/*
+    uniform values of the current program, open addressing on (program, loc)
+    1 -> value changed (or the table is full), the caller makes the call
+*/
+static int gls_uniform_changed(GLint loc, const float * v, int n) {
+    if(gls.program == GLS_UNKNOWN || gls.program == 0 || loc < 0) return 1;
+
+    unsigned int h = ((unsigned int)gls.program * 73856093u ^ (unsigned int)loc * 19349663u);
+    for(int probe = 0; probe < GLS_UNIFORM_SLOTS; probe++) {
+        struct gls_uniform * u = &gls.uniforms[(h + probe) & (GLS_UNIFORM_SLOTS - 1)];
+        if(u->program == 0) {
+            u->program = gls.program;
+            u->loc = loc;
+            u->n = n;
+            memcpy(u->v, v, sizeof(float) * n);
+            return 1;
+        }
+        if(u->program == gls.program && u->loc == loc) {
+            if(u->n == n && !memcmp(u->v, v, sizeof(float) * n)) return 0;
+            u->n = n;
+            memcpy(u->v, v, sizeof(float) * n);
+            return 1;
+        }
+    }
+    return 1;
+}
+
+void gls_uniform_mat4(GLint loc, const float * m) {
+    if(!gls_uniform_changed(loc, m, 16)) {
+        gls.elided++;
+        return;
+    }
+    gls.uniform_changes++;
+    glUniformMatrix4fv(loc, 1, GL_FALSE, m);
+}
+
+void gls_uniform_vec3(GLint loc, const float * v) {
+    if(!gls_uniform_changed(loc, v, 3)) {
+        gls.elided++;
+        return;
+    }
+    gls.uniform_changes++;
+    glUniform3fv(loc, 1, v);
+}
+
+void gls_uniform_1f(GLint loc, float v) {
+    if(!gls_uniform_changed(loc, &v, 1)) {
+        gls.elided++;
+        return;
+    }
+    gls.uniform_changes++;
+    glUniform1f(loc, v);
+}
+
+void gls_draw_arrays(GLenum mode, GLint first, GLsizei count) {
+    gls.draws++;
+    glDrawArrays(mode, first, count);
+}
+
+void gls_draw_arrays_instanced(GLenum mode, GLint first, GLsizei count, GLsizei instances) {
+    gls.draws++;
+    glDrawArraysInstanced(mode, first, count, instances);
+}
+
+// offset in bytes into the element buffer of the bound vao
+void gls_draw_elements(GLenum mode, GLsizei count, GLenum type, size_t offset) {
+    gls.draws++;
+    glDrawElements(mode, count, type, (void*)offset);
+}
+
+void gls_draw_elements_instanced(GLenum mode, GLsizei count, GLenum type, size_t offset, GLsizei instances) {
+    gls.draws++;
+    glDrawElementsInstanced(mode, count, type, (void*)offset, instances);
+}
+
+// frames = how many frames the counters cover
+void print_gl_state(unsigned long long int frames) {
+    unsigned long long int n = frames ? frames : 1;
+    printf("glstate:    %'9llu draws, %'llu state changes, %'llu uniform uploads, %'llu calls elided per frame (avg)\n",
+            gls.draws / n, gls.changes / n, gls.uniform_changes / n, gls.elided / n);
+}
+
+#endif /* STG_GLSTATE_H */
@@ -0,0 +1,170 @@
+#ifndef STG_GPUTIMER_H
+#define STG_GPUTIMER_H
+
+#include <stdio.h>
+#include <string.h>
+
+#include <GL/glew.h>
+
+#include "timing.h"
+
+/*
+    gpu timer:
+        TT_RENDER is cpu time, issuing gl calls + swap, it can not tell gpu
+        work from swap blocking, this measures the gpu side of each pass
+
+        a GL_TIMESTAMP query is put at the start of every pass (GT_*) and one
+        at the end of the frame, pass time = next stamp - own stamp
+        GPU_TIMER_SETS sets of queries are used round robin, results are
+        polled without blocking after the swap and land in the frame sample
+        they were issued for, usually 1 - 2 frames later
+        a set that is still not done when it comes around again is dropped,
+        the frame never waits for the gpu
+
+        needs gl 3.3 or ARB_timer_query, else enabled = 0 and nothing happens
+
+    per frame:
+        begin_gpu_frame(frame)
+        mark_gpu_pass(GT_SCENE) .. mark_gpu_pass(GT_BLIT)
+        end_gpu_frame()
+        swap
+        collect_gpu_timer()     -> poll_gpu_timer() until 0, into the frame samples
+*/
+
+#define GPU_TIMER_SETS  4
+
+struct gpu_timer {
+    int enabled;
+    GLuint queries[GPU_TIMER_SETS][GT_MAX + 1];  // pass starts + frame end
+
+    // per set
+    unsigned long long int frames[GPU_TIMER_SETS];
+    int marked[GPU_TIMER_SETS];     // bit per pass
+    int pending[GPU_TIMER_SETS];    // ended, result not read yet
+
+    int current;    // set of this frame, -1 outside begin / end
+    int next;       // set the next frame uses
+    int oldest;     // first set to poll
+
+    // stats
+    unsigned long long int measured, dropped;
+    unsigned long long int total_us[GT_MAX];
+};
+
+int has_timer_query(void) {
+    return GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+}
+
+void init_gpu_timer(struct gpu_timer * gt, int enabled) {
+    memset(gt, 0, sizeof(struct gpu_timer));
+    gt->enabled = enabled && has_timer_query();
+    gt->current = -1;
+    if(gt->enabled) glGenQueries(GPU_TIMER_SETS * (GT_MAX + 1), &gt->queries[0][0]);
+}
+
+// enabled is kept for the report
+void free_gpu_timer(struct gpu_timer * gt) {
+    if(gt->enabled) glDeleteQueries(GPU_TIMER_SETS * (GT_MAX + 1), &gt->queries[0][0]);
+    memset(gt->queries, 0, sizeof(gt->queries));
+    memset(gt->pending, 0, sizeof(gt->pending));
+    gt->current = -1;
+}
+
+// frame = the frame sample the results go to
+void begin_gpu_frame(struct gpu_timer * gt, unsigned long long int frame) {
+    if(!gt->enabled) return;
+
+    int set = gt->next;
+    if(gt->pending[set]) {
+        // gpu is more than GPU_TIMER_SETS frames behind or nobody polled
+        gt->pending[set] = 0;
+        gt->dropped++;
+        if(gt->oldest == set) gt->oldest = (set + 1) % GPU_TIMER_SETS;
+    }
+    gt->frames[set] = frame;
+    gt->marked[set] = 0;
+    gt->current = set;
+    gt->next = (set + 1) % GPU_TIMER_SETS;
+}
+
+// start of a pass, passes are marked in GT_* order
+void mark_gpu_pass(struct gpu_timer * gt, int pass) {
+    if(!gt->enabled || gt->current < 0) return;
+    glQueryCounter(gt->queries[gt->current][pass], GL_TIMESTAMP);
+    gt->marked[gt->current] |= 1 << pass;
+}
+
+void end_gpu_frame(struct gpu_timer * gt) {
+    if(!gt->enabled || gt->current < 0) return;
+    glQueryCounter(gt->queries[gt->current][GT_MAX], GL_TIMESTAMP);
+    gt->pending[gt->current] = 1;
+    gt->current = -1;
+}
+
+/*
+    oldest finished frame -> *frame + us[GT_MAX] (0 for passes that were not
+    marked), returns 0 when nothing is ready, never blocks
+*/
+int poll_gpu_timer(struct gpu_timer * gt, unsigned long long int * frame, unsigned int * us) {
+    if(!gt->enabled) return 0;
+
+    int set = gt->oldest;
+    if(!gt->pending[set]) return 0;
+
+    // the end stamp is the last one issued, when it is done all are
+    GLint available = GL_FALSE;
+    glGetQueryObjectiv(gt->queries[set][GT_MAX], GL_QUERY_RESULT_AVAILABLE, &available);
+    if(available != GL_TRUE) return 0;
+
+    GLuint64 stamps[GT_MAX + 1];
+    for(int i = 0; i <= GT_MAX; i++) {
+        stamps[i] = 0;
+        if(i == GT_MAX || (gt->marked[set] & (1 << i))) {
+            glGetQueryObjectui64v(gt->queries[set][i], GL_QUERY_RESULT, &stamps[i]);
+        }
+    }
+
+    // a pass ends where the next marked one (or the frame) starts
+    for(int i = 0; i < GT_MAX; i++) {
+        us[i] = 0;
+        if(!(gt->marked[set] & (1 << i))) continue;
+        int j = i + 1;
+        while(j < GT_MAX && !(gt->marked[set] & (1 << j))) j++;
+        us[i] = stamps[j] > stamps[i] ? (unsigned int)((stamps[j] - stamps[i]) / 1000) : 0;
+        gt->total_us[i] += us[i];
+    }
+
+    *frame = gt->frames[set];
+    gt->pending[set] = 0;
+    gt->oldest = (set + 1) % GPU_TIMER_SETS;
+    gt->measured++;
+    return 1;
+}
+
+// everything that is ready -> the frame samples
+void collect_gpu_timer(struct gpu_timer * gt, struct frame_timings * ft) {
+    unsigned long long int frame;
+    unsigned int us[GT_MAX];
+
+    while(poll_gpu_timer(gt, &frame, us)) {
+        struct frame_sample_s * fs = find_frame_timings(ft, frame);
+        if(fs == NULL) continue;
+        memcpy(fs->gpu, us, sizeof(us));
+        fs->gpu_measured = 1;
+    }
+}
+
+void print_gpu_timer(struct gpu_timer * gt) {
+    if(!gt->enabled) {
+        printf("gpu:        %9s\n", "off / no timer queries");
+        return;
+    }
+    unsigned long long int n = gt->measured ? gt->measured : 1;
+    printf("gpu:        %'9llu frames measured, %'llu dropped,", gt->measured, gt->dropped);
+    for(int i = 0; i < GT_MAX; i++) {
+        printf(" %s %'llu us", gpu_tag_name[i], gt->total_us[i] / n);
+    }
+    printf(" per frame (avg)\n");
+}
+
+#endif /* STG_GPUTIMER_H */
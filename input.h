@@ -1,172 +1,330 @@
 #ifndef STG_INPUT_H
 #define STG_INPUT_H
 
-#include <SDL2/sdl.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <SDL2/SDL.h>
 
 /*
+    input:
+        keyboard state is a bitset over the scancodes (8 words), the previous
+        frame is a copy of that, pressed / released are a few word wide xors
+        at the end of the frame, nothing per frame scales with SDL_NUM_SCANCODES
+
+        every key event of the frame is kept in order in an event list, so
+        "first key pressed this frame" only looks at what happened
+
+        actions: any number, bound to keys through a binding list (many keys
+        -> one action, one action per key), the list is compiled into a
+        scancode -> action table whenever it changes
+        an action is held while any of its keys is, counted per event
+
+    per frame:
+        begin_input_frame()
+        input_event() for every sdl event
+        end_input_frame()
+        do_input_remapping() (optional)
+
+    event time:
+        sdl timestamps are ms since SDL_Init, sync_input_clock() keeps the
+        offset to get_time_us(), the smallest one seen is the closest (ticks
+        are truncated), input_event_us() puts an event mid-millisecond
+
+    late latch:
+        peek_input_actions() looks at key events that arrived after the frame
+        was read without taking them out of the queue, the next frame still
+        reads them as usual
+
     TODO:
-        make input module actually usable
         add controller support
         add joystick support
-
-        add polling for PRESSED / DOWN / VALUE
         add per-action registers for how it should ideally read input values
             (key instead of controller joystick axis)
 
-        add recording / streaming io for testing (independant of FPS)
+    recording / replay: inputlog.h
 */
 
-struct input_key {
-    // int tag; // action key map
-    long int keysym;
-    int value;
-};
+#define INPUT_WORD_BITS     64
+#define INPUT_WORDS         ((SDL_NUM_SCANCODES + INPUT_WORD_BITS - 1) / INPUT_WORD_BITS)
+#define INPUT_REMAP_KEY     SDL_SCANCODE_Q
 
-struct index_map {
-    int from;
-    int to;
+typedef unsigned long long int input_bits;
+
+struct input_event {
+    int scancode;
+    int down;
+    unsigned int timestamp;     // sdl ms
 };
 
-struct input_action_key {
-    int tag;
-    union {
-        int i;
-        float f;
-    } value;
+struct input_binding {
+    int scancode;
+    int action;
 };
 
-#define NUM_ACTIONS     4
+// action_state bits
+#define INPUT_HELD      1
+#define INPUT_PRESSED   2
+#define INPUT_RELEASED  4
+
 struct input {
+    // keys, bit per scancode
+    input_bits keys[INPUT_WORDS];
+    input_bits prev[INPUT_WORDS];
+    input_bits pressed[INPUT_WORDS];
+    input_bits released[INPUT_WORDS];
+
+    // this frame's key events, in order
+    int num_events, cap_events;
+    struct input_event * events;
+
+    int num_bindings, cap_bindings;
+    struct input_binding * bindings;
+    short key_action[SDL_NUM_SCANCODES];    // compiled bindings, -1 -> none
+
+    int num_actions;
+    int * action_keys;                      // keys held per action
+    int * latch_keys;                       // peek_input_actions() scratch
+    unsigned char * action_state;           // INPUT_* bits
+
+    // remapping
     int is_remapping;
-    int im_index;
-    struct index_map c_im_kb;
-
-    // current frame
-    int                     in_kb[SDL_NUM_SCANCODES];
-    struct index_map        im_kb[NUM_ACTIONS];
-    struct input_action_key iak[NUM_ACTIONS];
-
-    // prev frame
-    int                     in_kb_prev[SDL_NUM_SCANCODES];
-    struct index_map        im_kb_prev[NUM_ACTIONS];
-    struct input_action_key iak_prev[NUM_ACTIONS];
+    int remap_binding;                      // binding waiting for a new key, -1 -> none
+
+    // sdl ms -> get_time_us()
+    int clock_synced;
+    long long int clock_offset_us;
 };
 
-void init_input(struct input * inp) {
-    inp->is_remapping = 0;
-    inp->im_index = 0;
-    inp->c_im_kb.from = -1;
-    inp->c_im_kb.to = -1;
-    
-    memset(inp->in_kb, 0, sizeof(int) * SDL_NUM_SCANCODES);
-    memset(inp->in_kb_prev, 0, sizeof(int) * SDL_NUM_SCANCODES);
-    
-    inp->im_kb[0].from = SDL_SCANCODE_LEFT;
-    inp->im_kb[0].to = 0;
-    inp->im_kb[1].from = SDL_SCANCODE_RIGHT;
-    inp->im_kb[1].to = 1;
-    inp->im_kb[2].from = SDL_SCANCODE_DOWN;
-    inp->im_kb[2].to = 2;
-    inp->im_kb[3].from = SDL_SCANCODE_UP;
-    inp->im_kb[3].to = 3;
-
-    memset(inp->iak, 0, sizeof(struct input_action_key) * NUM_ACTIONS);
-    memset(inp->iak_prev, 0, sizeof(struct input_action_key) * NUM_ACTIONS);
-    inp->iak[0].tag = 0;
-    inp->iak[1].tag = 1;
-    inp->iak[2].tag = 2;
-    inp->iak[3].tag = 3;
+static inline int input_bit(const input_bits * bits, int scancode) {
+    return (bits[scancode / INPUT_WORD_BITS] >> (scancode % INPUT_WORD_BITS)) & 1;
 }
 
-void do_input(struct input * inp) {
-    struct index_map _im;
-    for(int i = 0; i < NUM_ACTIONS; i++) {
-        _im = im_kb[i];
-        if(_im.from > -1 && _im.to > -1) {
-            iak[_im.to].value.i = in_kb[_im.from];
-        } else {
-            // something is wrong with the mapping, clear to 0
-            if(_im.to > -1) iak[_im.to].value.i = 0;
-        }
+int key_down(struct input * inp, int scancode) { return input_bit(inp->keys, scancode); }
+int key_pressed(struct input * inp, int scancode) { return input_bit(inp->pressed, scancode); }
+int key_released(struct input * inp, int scancode) { return input_bit(inp->released, scancode); }
+
+int action_down(struct input * inp, int action) { return (inp->action_state[action] & INPUT_HELD) != 0; }
+int action_pressed(struct input * inp, int action) { return (inp->action_state[action] & INPUT_PRESSED) != 0; }
+int action_released(struct input * inp, int action) { return (inp->action_state[action] & INPUT_RELEASED) != 0; }
+
+void init_input(struct input * inp, int num_actions) {
+    memset(inp, 0, sizeof(struct input));
+
+    inp->cap_events = 64;
+    inp->events = malloc(sizeof(struct input_event) * inp->cap_events);
+    inp->cap_bindings = 16;
+    inp->bindings = malloc(sizeof(struct input_binding) * inp->cap_bindings);
+    for(int i = 0; i < SDL_NUM_SCANCODES; i++) inp->key_action[i] = -1;
+
+    inp->num_actions = num_actions;
+    inp->action_keys = calloc(num_actions, sizeof(int));
+    inp->latch_keys = calloc(num_actions, sizeof(int));
+    inp->action_state = calloc(num_actions, sizeof(unsigned char));
+
+    inp->remap_binding = -1;
+}
+
+void free_input(struct input * inp) {
+    free(inp->events);
+    free(inp->bindings);
+    free(inp->action_keys);
+    free(inp->latch_keys);
+    free(inp->action_state);
+    inp->events = NULL;
+    inp->bindings = NULL;
+    inp->action_keys = NULL;
+    inp->latch_keys = NULL;
+    inp->action_state = NULL;
+}
+
+// bindings -> table, held counts follow the keys that are down right now
+static void compile_input_bindings(struct input * inp) {
+    for(int i = 0; i < SDL_NUM_SCANCODES; i++) inp->key_action[i] = -1;
+    memset(inp->action_keys, 0, sizeof(int) * inp->num_actions);
+
+    for(int i = 0; i < inp->num_bindings; i++) {
+        struct input_binding * b = &inp->bindings[i];
+        if(b->scancode < 0) continue;
+        inp->key_action[b->scancode] = b->action;
+        if(key_down(inp, b->scancode)) inp->action_keys[b->action]++;
+    }
+    // edges of the old table would not be cleared by begin_input_frame()
+    for(int a = 0; a < inp->num_actions; a++) {
+        inp->action_state[a] = inp->action_keys[a] > 0 ? INPUT_HELD : 0;
     }
 }
 
-void do_input_remapping(struct input * inp) {
-    // check if remapping is to be done
-    if(in_kb[SDL_SCANCODE_Q] && !in_kb_prev[SDL_SCANCODE_Q]) { // hacky inital check
-        is_remapping = !is_remapping;
-        if(is_remapping) {
-            printf("start remapping\n");
-            c_im_kb.from = -1;
-            c_im_kb.to = -1;
-            im_index = -1;
-        } else {
-            printf("stopped remapping\n");
-            c_im_kb.from = -1;
-            c_im_kb.to = -1;
-            im_index = -1;
+// a key drives one action, binding it again moves it
+void bind_input(struct input * inp, int scancode, int action) {
+    for(int i = 0; i < inp->num_bindings; i++) {
+        if(inp->bindings[i].scancode == scancode) {
+            inp->bindings[i].action = action;
+            compile_input_bindings(inp);
+            return;
         }
     }
+    if(inp->num_bindings == inp->cap_bindings) {
+        inp->cap_bindings *= 2;
+        inp->bindings = realloc(inp->bindings, sizeof(struct input_binding) * inp->cap_bindings);
+    }
+    inp->bindings[inp->num_bindings].scancode = scancode;
+    inp->bindings[inp->num_bindings].action = action;
+    inp->num_bindings++;
+    compile_input_bindings(inp);
+}
+
+void begin_input_frame(struct input * inp) {
+    // only actions touched last frame have edges to clear
+    for(int i = 0; i < inp->num_events; i++) {
+        int a = inp->key_action[inp->events[i].scancode];
+        if(a >= 0) inp->action_state[a] &= INPUT_HELD;
+    }
+    inp->num_events = 0;
+    memcpy(inp->prev, inp->keys, sizeof(inp->keys));
+}
+
+// key events are used, everything else is ignored, returns 1 when used
+int input_event(struct input * inp, SDL_Event * e) {
+    if(e->type != SDL_KEYDOWN && e->type != SDL_KEYUP) return 0;
+    if(e->key.repeat) return 1;
+
+    int sc = e->key.keysym.scancode;
+    int down = e->type == SDL_KEYDOWN;
+    if(sc < 0 || sc >= SDL_NUM_SCANCODES || input_bit(inp->keys, sc) == down) return 1;
+
+    input_bits mask = 1ull << (sc % INPUT_WORD_BITS);
+    if(down) inp->keys[sc / INPUT_WORD_BITS] |= mask;
+    else inp->keys[sc / INPUT_WORD_BITS] &= ~mask;
+
+    if(inp->num_events == inp->cap_events) {
+        inp->cap_events *= 2;
+        inp->events = realloc(inp->events, sizeof(struct input_event) * inp->cap_events);
+    }
+    struct input_event * ev = &inp->events[inp->num_events++];
+    ev->scancode = sc;
+    ev->down = down;
+    ev->timestamp = e->key.timestamp;
 
-    // logic for the swaps
-    if(is_remapping && !in_kb[SDL_SCANCODE_Q]) {
-        const char * scancode_name = NULL;
-        
-        if(im_index == -1) {
-            // await scancode to edit
-            
-            // find first key pressed this frame using scancode
-            for(int i = 0; i < SDL_NUM_SCANCODES; i++) {
-                if(in_kb[i] && !in_kb_prev[i]) {
-                    
-                    scancode_name = SDL_GetScancodeName(i);
-                    printf("check scancode: %i, %s\n", i, scancode_name); 
-                    
-                    // find if scancode is actually used in current mapping
-                    for(int j = 0; j < 4; j++) {
-                        if(im_kb[j].from == i) {
-                            printf("found mapping at %i for given scancode %i, %s\n", j, i, scancode_name);
-                            im_index = j;
-                            break;
-                        } 
-                    }
-
-                    if(im_index == -1)
-                        printf("scancode %i, %s is not used in any mappings\n", i, scancode_name);
-    
-                }               
+    int a = inp->key_action[sc];
+    if(a >= 0) {
+        if(down) {
+            if(inp->action_keys[a]++ == 0) inp->action_state[a] |= INPUT_HELD | INPUT_PRESSED;
+        } else if(inp->action_keys[a] > 0) {
+            if(--inp->action_keys[a] == 0) {
+                inp->action_state[a] &= ~INPUT_HELD;
+                inp->action_state[a] |= INPUT_RELEASED;
             }
-        } else {
-            // await scancode to swap to
-
-            // find first key pressed this frame using scancode
-            for(int i = 0; i < SDL_NUM_SCANCODES; i++) {
-                if(in_kb[i] && !in_kb_prev[i]) {
-
-                    const char * prev_scancode_name = SDL_GetScancodeName(im_kb[im_index].from);
-                    scancode_name = SDL_GetScancodeName(i);
-
-                    printf("changed scancode %i, %s to %i, %s\n", 
-                                            im_kb[im_index].from, prev_scancode_name, 
-                                            i, scancode_name);
-                    
-                    im_kb[im_index].from = i;
-
-                    // TODO: handle multiple mappings using the same key -> removal
-                    for(int j = 0; j < 4; j++) {
-                        if(j != im_index) {
-                            if(im_kb[j].from == i) {
-                                // mapping already existed. prioritise the new mapping and remove the previus one.
-                                im_kb[j].from = -1;
-                            }
-                        }
-                    }
-
-                    im_index = -1;
-                    break;
-                }
+        }
+    }
+    return 1;
+}
+
+// edges against last frame, a tap inside one frame is neither pressed nor released
+void end_input_frame(struct input * inp) {
+    for(int i = 0; i < INPUT_WORDS; i++) {
+        input_bits changed = inp->keys[i] ^ inp->prev[i];
+        inp->pressed[i] = changed & inp->keys[i];
+        inp->released[i] = changed & inp->prev[i];
+    }
+}
+
+// first key that went down this frame and still is, -1 -> none
+int first_pressed_key(struct input * inp) {
+    for(int i = 0; i < inp->num_events; i++) {
+        int sc = inp->events[i].scancode;
+        if(inp->events[i].down && key_pressed(inp, sc)) return sc;
+    }
+    return -1;
+}
+
+// now_us = get_time_us(), SDL_GetTicks() is read right after it
+void sync_input_clock(struct input * inp, unsigned long long int now_us) {
+    long long int offset = (long long int)now_us - (long long int)SDL_GetTicks() * 1000;
+    if(!inp->clock_synced || offset < inp->clock_offset_us) inp->clock_offset_us = offset;
+    inp->clock_synced = 1;
+}
+
+// sdl event timestamp -> get_time_us(), 0 before the first sync
+unsigned long long int input_event_us(struct input * inp, unsigned int timestamp) {
+    if(!inp->clock_synced) return 0;
+    return (long long int)timestamp * 1000 + inp->clock_offset_us + 500;
+}
+
+/*
+    actions[num_actions] = what would be held if the key events waiting in
+    the sdl queue were read now, returns how many were looked at
+    (at most INPUT_LATCH_EVENTS, the rest is left for the next frame)
+*/
+#define INPUT_LATCH_EVENTS  32
+
+int peek_input_actions(struct input * inp, int * actions) {
+    SDL_Event events[INPUT_LATCH_EVENTS];
+    input_bits keys[INPUT_WORDS];
+
+    SDL_PumpEvents();
+    int n = SDL_PeepEvents(events, INPUT_LATCH_EVENTS, SDL_PEEKEVENT, SDL_KEYDOWN, SDL_KEYUP);
+    if(n < 0) n = 0;
+
+    memcpy(keys, inp->keys, sizeof(keys));
+    memcpy(inp->latch_keys, inp->action_keys, sizeof(int) * inp->num_actions);
+    for(int i = 0; i < n; i++) {
+        SDL_KeyboardEvent * k = &events[i].key;
+        int sc = k->keysym.scancode;
+        int down = k->type == SDL_KEYDOWN;
+        if(k->repeat || sc < 0 || sc >= SDL_NUM_SCANCODES || input_bit(keys, sc) == down) continue;
+
+        keys[sc / INPUT_WORD_BITS] ^= 1ull << (sc % INPUT_WORD_BITS);
+        int a = inp->key_action[sc];
+        if(a >= 0) inp->latch_keys[a] += down ? 1 : -1;
+    }
+    for(int a = 0; a < inp->num_actions; a++) actions[a] = inp->latch_keys[a] > 0;
+    return n;
+}
+
+/*
+    INPUT_REMAP_KEY toggles remapping, then:
+        press a bound key       -> that binding is picked
+        press any key           -> the picked binding moves to it, a binding
+                                   that already used the key is removed
+*/
+void do_input_remapping(struct input * inp) {
+    if(key_pressed(inp, INPUT_REMAP_KEY)) {
+        inp->is_remapping = !inp->is_remapping;
+        inp->remap_binding = -1;
+        printf(inp->is_remapping ? "start remapping\n" : "stopped remapping\n");
+    }
+    if(!inp->is_remapping || key_down(inp, INPUT_REMAP_KEY)) return;
+
+    int sc = first_pressed_key(inp);
+    if(sc < 0) return;
+    const char * scancode_name = SDL_GetScancodeName(sc);
+
+    if(inp->remap_binding == -1) {
+        // await scancode to edit
+        printf("check scancode: %i, %s\n", sc, scancode_name);
+        for(int i = 0; i < inp->num_bindings; i++) {
+            if(inp->bindings[i].scancode == sc) {
+                printf("found mapping at %i for given scancode %i, %s\n", i, sc, scancode_name);
+                inp->remap_binding = i;
+                break;
             }
         }
+        if(inp->remap_binding == -1) printf("scancode %i, %s is not used in any mappings\n", sc, scancode_name);
+    } else {
+        // await scancode to swap to
+        struct input_binding * b = &inp->bindings[inp->remap_binding];
+        printf("changed scancode %i, %s to %i, %s\n", b->scancode,
+                b->scancode >= 0 ? SDL_GetScancodeName(b->scancode) : "none", sc, scancode_name);
+
+        // the new mapping wins over one that used the key before
+        for(int i = 0; i < inp->num_bindings; i++) {
+            if(i != inp->remap_binding && inp->bindings[i].scancode == sc) inp->bindings[i].scancode = -1;
+        }
+        b->scancode = sc;
+        compile_input_bindings(inp);
+        inp->remap_binding = -1;
     }
 }
 
@@ -0,0 +1,323 @@
+#ifndef STG_INPUTLOG_H
+#define STG_INPUTLOG_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sim.h"
+#include "snakes.h"
+#include "input.h"
+
+/*
+    input log:
+        append only binary file of the input a session fed into the sim,
+        keyed by sim tick instead of time -> a replay runs the same ticks
+        with the same actions at any frame rate / speed and ends on the same
+        state bit for bit (sim + snakes are deterministic from the seed)
+
+        the sim is driven by the action records, key records are the raw
+        scancodes behind them (remapping included) and are only kept for
+        looking at, replay skips them
+
+    file:
+        header      IL_MAGIC, version, tick_us, actions, snakes, segments, iterations (u32 le)
+        records     varint tick delta, kind byte, varint code, varint ms delta
+                    kind = IL_* | IL_DOWN, ms = since the log was opened
+        end         IL_END record, code = hash of the final state
+                    (a log without one, e.g. after a crash, replays until its last record)
+
+    recording:
+        log_input_key() for the frame's key events, log_input_actions() with
+        the actions the next ticks will see, both at the tick that runs next,
+        the same tick can be written more than once, the last record wins
+        writes go through a IL_BUFFER byte buffer, flushed when full / closed
+
+    replay:
+        the whole file is read at open, replay_input_actions() before every
+        tick sets the actions for it, returns 0 once the log is done
+        the replay should stop on the end tick, the state hash is compared
+        with the recorded one in the report
+*/
+
+#define IL_MAGIC        0x49475453u     // "STGI"
+#define IL_VERSION      1
+#define IL_BUFFER       (64 * 1024)
+
+// record kinds, low bit = down
+#define IL_DOWN         1
+#define IL_ACTION       2
+#define IL_KEY          4
+#define IL_END          8
+
+#define IL_RECORD       1
+#define IL_REPLAY       2
+
+struct input_log_header {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int tick_us;
+    unsigned int num_actions;
+    unsigned int snake_count;
+    unsigned int snake_segments;
+    unsigned int snake_iterations;
+};
+
+struct input_log {
+    int mode;                               // IL_RECORD / IL_REPLAY, 0 -> closed
+    struct input_log_header header;
+    FILE * file;
+
+    // record: write buffer, replay: whole file
+    unsigned char * buf;
+    size_t len, pos;
+
+    unsigned long long int tick;            // of the last record
+    unsigned long long int ms;              // of the last record
+    unsigned long long int start_us;
+    int actions[SA_MAX];                    // state after the last record
+
+    int done;                               // replay: end reached
+    int has_end;
+    unsigned long long int end_tick;
+    unsigned int end_hash;
+
+    // stats
+    unsigned long long int records, keys, bytes;
+};
+
+static void put_header_u32(unsigned char * p, unsigned int v) {
+    p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static unsigned int get_header_u32(const unsigned char * p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static void flush_input_log(struct input_log * log) {
+    if(log->len && fwrite(log->buf, 1, log->len, log->file) != log->len) {
+        printf("input log: write failed, %zu bytes lost\n", log->len);
+    }
+    log->bytes += log->len;
+    log->len = 0;
+}
+
+static void put_input_log_varint(struct input_log * log, unsigned long long int v) {
+    // 10 bytes is the longest varint
+    if(log->len + 10 > IL_BUFFER) flush_input_log(log);
+    do {
+        unsigned char b = v & 0x7f;
+        v >>= 7;
+        log->buf[log->len++] = b | (v ? 0x80 : 0);
+    } while(v);
+}
+
+// 0 -> truncated
+static int get_input_log_varint(struct input_log * log, unsigned long long int * v) {
+    int shift = 0;
+    *v = 0;
+    while(log->pos < log->len && shift < 64) {
+        unsigned char b = log->buf[log->pos++];
+        *v |= (unsigned long long int)(b & 0x7f) << shift;
+        if(!(b & 0x80)) return 1;
+        shift += 7;
+    }
+    return 0;
+}
+
+static void put_input_log_record(struct input_log * log, unsigned long long int tick, int kind, unsigned int code) {
+    unsigned long long int ms = (get_time_us() - log->start_us) / 1000;
+
+    put_input_log_varint(log, tick - log->tick);
+    put_input_log_varint(log, kind);
+    put_input_log_varint(log, code);
+    put_input_log_varint(log, ms - log->ms);
+    log->tick = tick;
+    log->ms = ms;
+    log->records++;
+}
+
+// header is filled in by the caller for IL_RECORD, read into log->header for IL_REPLAY, 0 -> failed
+int open_input_log(struct input_log * log, const char * path, int mode, struct input_log_header * header) {
+    memset(log, 0, sizeof(struct input_log));
+    log->start_us = get_time_us();
+
+    log->file = fopen(path, mode == IL_RECORD ? "wb" : "rb");
+    if(log->file == NULL) {
+        printf("input log: could not open %s\n", path);
+        return 0;
+    }
+
+    if(mode == IL_RECORD) {
+        unsigned char h[sizeof(struct input_log_header)];
+        log->header = *header;
+        log->header.magic = IL_MAGIC;
+        log->header.version = IL_VERSION;
+        for(unsigned int i = 0; i < sizeof(h) / 4; i++) put_header_u32(h + 4 * i, ((unsigned int *)&log->header)[i]);
+
+        log->buf = malloc(IL_BUFFER);
+        memcpy(log->buf, h, sizeof(h));
+        log->len = sizeof(h);
+        log->mode = mode;
+        return 1;
+    }
+
+    fseek(log->file, 0, SEEK_END);
+    long size = ftell(log->file);
+    fseek(log->file, 0, SEEK_SET);
+    if(size < (long)sizeof(struct input_log_header)) {
+        printf("input log: %s is too short\n", path);
+        fclose(log->file);
+        log->file = NULL;
+        return 0;
+    }
+
+    log->buf = malloc(size);
+    log->len = fread(log->buf, 1, size, log->file);
+    fclose(log->file);
+    log->file = NULL;
+
+    for(unsigned int i = 0; i < sizeof(struct input_log_header) / 4; i++) {
+        ((unsigned int *)&log->header)[i] = get_header_u32(log->buf + 4 * i);
+    }
+    if(log->header.magic != IL_MAGIC || log->header.version != IL_VERSION || log->header.num_actions > SA_MAX
+            || log->header.tick_us == 0) {
+        printf("input log: %s is not an input log (version %d)\n", path, IL_VERSION);
+        free(log->buf);
+        log->buf = NULL;
+        return 0;
+    }
+    log->pos = sizeof(struct input_log_header);
+    log->bytes = log->len;
+    log->mode = mode;
+    if(header) *header = log->header;
+    return 1;
+}
+
+// record: writes the end record + flushes, hash = of the final state
+void close_input_log(struct input_log * log, unsigned long long int tick, unsigned int hash) {
+    if(log->mode == IL_RECORD) {
+        put_input_log_record(log, tick, IL_END, hash);
+        flush_input_log(log);
+        fclose(log->file);
+        log->file = NULL;
+    }
+    // mode is kept for the report
+    free(log->buf);
+    log->buf = NULL;
+}
+
+void log_input_key(struct input_log * log, unsigned long long int tick, struct input_event * ev) {
+    if(log->mode != IL_RECORD) return;
+    put_input_log_record(log, tick, IL_KEY | (ev->down ? IL_DOWN : 0), ev->scancode);
+    log->keys++;
+}
+
+// only actions that changed since the last record are written
+void log_input_actions(struct input_log * log, unsigned long long int tick, const int * actions) {
+    if(log->mode != IL_RECORD) return;
+    for(int i = 0; i < (int)log->header.num_actions; i++) {
+        int down = actions[i] != 0;
+        if(down == log->actions[i]) continue;
+        put_input_log_record(log, tick, IL_ACTION | (down ? IL_DOWN : 0), i);
+        log->actions[i] = down;
+    }
+}
+
+/*
+    actions for the tick that runs next, every record up to and including
+    that tick is applied, returns 0 when the log has nothing for it
+    (end record reached or data ran out), actions are left as they were
+*/
+int replay_input_actions(struct input_log * log, unsigned long long int tick, int * actions) {
+    if(log->mode != IL_REPLAY || log->done) return 0;
+
+    while(log->pos < log->len) {
+        size_t at = log->pos;
+        unsigned long long int dt, kind, code, dms;
+        if(!get_input_log_varint(log, &dt)) break;
+        if(log->tick + dt > tick) {
+            log->pos = at;
+            break;
+        }
+        if(!get_input_log_varint(log, &kind) || !get_input_log_varint(log, &code)
+                || !get_input_log_varint(log, &dms)) {
+            log->pos = log->len;
+            break;
+        }
+        log->tick += dt;
+        log->ms += dms;
+        log->records++;
+
+        if(kind & IL_END) {
+            log->has_end = 1;
+            log->end_tick = log->tick;
+            log->end_hash = code;
+            log->done = 1;
+            return 0;
+        } else if(kind & IL_ACTION) {
+            if(code < log->header.num_actions) log->actions[code] = kind & IL_DOWN;
+        } else if(kind & IL_KEY) {
+            log->keys++;
+        }
+    }
+    if(log->pos >= log->len) {
+        // no end record, keep going until the last record's tick has run
+        if(tick > log->tick) {
+            log->done = 1;
+            return 0;
+        }
+    }
+
+    for(int i = 0; i < (int)log->header.num_actions; i++) actions[i] = log->actions[i];
+    return 1;
+}
+
+static unsigned int hash_bytes(unsigned int h, const void * data, size_t n) {
+    const unsigned char * p = data;
+    for(size_t i = 0; i < n; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// fnv-1a of everything a replay has to reproduce, field by field (no padding)
+unsigned int hash_sim_state(struct sim_state * s, struct snakes * sn) {
+    size_t n = (size_t)sn->stride * sn->segments;
+    unsigned int h = 2166136261u;
+
+    h = hash_bytes(h, &s->tick, sizeof(s->tick));
+    h = hash_bytes(h, &s->player.pos, sizeof(vec3));
+    h = hash_bytes(h, &s->player.vel, sizeof(vec3));
+    h = hash_bytes(h, &s->player.rot, sizeof(vec3));
+    h = hash_bytes(h, &s->fire_cooldown, sizeof(float));
+    for(int i = 0; i < MAX_SPEARS; i++) {
+        h = hash_bytes(h, &s->spears[i].pos, sizeof(vec3));
+        h = hash_bytes(h, &s->spears[i].vel, sizeof(vec3));
+        h = hash_bytes(h, &s->spears[i].life, sizeof(float));
+    }
+    h = hash_bytes(h, sn->x, sizeof(float) * n);
+    h = hash_bytes(h, sn->y, sizeof(float) * n);
+    h = hash_bytes(h, sn->px, sizeof(float) * n);
+    h = hash_bytes(h, sn->py, sizeof(float) * n);
+    return h;
+}
+
+// hash = of the final state
+void print_input_log(struct input_log * log, unsigned int hash) {
+    if(log->mode == IL_RECORD) {
+        printf("input log:  %'9llu records (%'llu keys), %'llu bytes, recorded up to tick %'llu, state %08x\n",
+                log->records, log->keys, log->bytes, log->tick, hash);
+    } else if(log->mode == IL_REPLAY) {
+        printf("input log:  %'9llu records (%'llu keys) replayed, %'llu bytes, ", log->records, log->keys, log->bytes);
+        if(log->has_end) {
+            printf("end tick %'llu, state %08x, recorded %08x -> %s\n", log->end_tick, hash, log->end_hash,
+                    hash == log->end_hash ? "match" : "MISMATCH");
+        } else {
+            printf("no end record, state %08x not checked\n", hash);
+        }
+    }
+}
+
+#endif /* STG_INPUTLOG_H */
@@ -0,0 +1,166 @@
+#ifndef STG_INPUTQUEUE_H
+#define STG_INPUTQUEUE_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include <SDL2/SDL.h>
+
+#include "input.h"
+
+/*
+    input queue:
+        key events are caught by an sdl event watch and go into a single
+        producer / single consumer ring of 8 byte records, the sim is the
+        consumer and drains the ring at every tick boundary up to that
+        tick's place in time, no locks and no trip through the main loop's
+        own input state
+
+        records carry the sdl event timestamp, mapped to get_time_us() with
+        input_event_us() at drain time (the offset is kept by the main loop)
+        the watch runs wherever sdl pumps events, here inside SDL_PollEvent
+        in the input stage, and sdl2 stamps events when they are pumped,
+        so a key read this frame lands on the frame's last tick only, the
+        held actions of -event_queue=0 reach all of the frame's ticks
+        -> off by default, the ring is the way in for a sim / worker thread
+           that does not run in step with the main loop
+
+        producer: head, writes a record then publishes head (release)
+        consumer: tail, reads head (acquire), frees slots by publishing tail
+        each side keeps a cached copy of the other end and only reloads it
+        when the ring looks full / empty -> no shared cache line on the
+        common path, push and pop are wait-free
+        a full ring drops the event (counted), the producer never waits
+
+        consumer side keeps its own key bitset, actions come from the input
+        bindings (key_action) at drain time so remapping just works
+
+        one consumer at a time, the update job may move between threads as
+        long as its runs are ordered (job counter waits are the fence)
+*/
+
+#define INPUT_QUEUE_SIZE    256     // power of 2
+
+struct input_record {
+    unsigned int ms;            // sdl event timestamp
+    unsigned short scancode;
+    unsigned char down;
+    unsigned char pad;
+};
+
+struct input_queue {
+    // producer
+    atomic_uint head;
+    unsigned int cached_tail;
+    unsigned long long int pushed, dropped;
+    char pad0[64 - sizeof(atomic_uint) - sizeof(unsigned int) - 2 * sizeof(unsigned long long int)];
+
+    // consumer
+    atomic_uint tail;
+    unsigned int cached_head;
+    unsigned long long int popped;
+    unsigned int max_depth;
+    char pad1[64 - sizeof(atomic_uint) - 2 * sizeof(unsigned int) - sizeof(unsigned long long int)];
+
+    struct input_record records[INPUT_QUEUE_SIZE];
+    input_bits keys[INPUT_WORDS];
+    int attached;
+};
+
+void init_input_queue(struct input_queue * q) {
+    memset(q, 0, sizeof(struct input_queue));
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+}
+
+// producer, 0 -> full, dropped
+int push_input_queue(struct input_queue * q, struct input_record * r) {
+    unsigned int h = atomic_load_explicit(&q->head, memory_order_relaxed);
+    if(h - q->cached_tail == INPUT_QUEUE_SIZE) {
+        q->cached_tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+        if(h - q->cached_tail == INPUT_QUEUE_SIZE) {
+            q->dropped++;
+            return 0;
+        }
+    }
+    q->records[h & (INPUT_QUEUE_SIZE - 1)] = *r;
+    atomic_store_explicit(&q->head, h + 1, memory_order_release);
+    q->pushed++;
+    return 1;
+}
+
+// consumer, oldest record without taking it, NULL -> empty
+struct input_record * peek_input_queue(struct input_queue * q) {
+    unsigned int t = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    if(t == q->cached_head) {
+        q->cached_head = atomic_load_explicit(&q->head, memory_order_acquire);
+        if(t == q->cached_head) return NULL;
+        if(q->cached_head - t > q->max_depth) q->max_depth = q->cached_head - t;
+    }
+    return &q->records[t & (INPUT_QUEUE_SIZE - 1)];
+}
+
+// consumer, after peek_input_queue() returned a record
+void pop_input_queue(struct input_queue * q) {
+    unsigned int t = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    atomic_store_explicit(&q->tail, t + 1, memory_order_release);
+    q->popped++;
+}
+
+// sdl event watch, runs on the thread that pushes the event
+static int input_queue_watch(void * data, SDL_Event * e) {
+    if((e->type != SDL_KEYDOWN && e->type != SDL_KEYUP) || e->key.repeat) return 0;
+
+    struct input_record r;
+    r.ms = e->key.timestamp;
+    r.scancode = e->key.keysym.scancode;
+    r.down = e->type == SDL_KEYDOWN;
+    r.pad = 0;
+    push_input_queue(data, &r);
+    return 0;
+}
+
+void attach_input_queue(struct input_queue * q) {
+    SDL_AddEventWatch(input_queue_watch, q);
+    q->attached = 1;
+}
+
+void detach_input_queue(struct input_queue * q) {
+    if(q->attached) SDL_DelEventWatch(input_queue_watch, q);
+    q->attached = 0;
+}
+
+/*
+    consumer, before a tick: records stamped up to until_us -> key state,
+    actions[num_actions] = held through the bindings of inp
+    later records stay for the next tick
+*/
+void drain_input_queue(struct input_queue * q, unsigned long long int until_us, struct input * inp, int * actions) {
+    struct input_record * r;
+    while((r = peek_input_queue(q)) != NULL && input_event_us(inp, r->ms) <= until_us) {
+        if(r->scancode < SDL_NUM_SCANCODES) {
+            input_bits mask = 1ull << (r->scancode % INPUT_WORD_BITS);
+            if(r->down) q->keys[r->scancode / INPUT_WORD_BITS] |= mask;
+            else q->keys[r->scancode / INPUT_WORD_BITS] &= ~mask;
+        }
+        pop_input_queue(q);
+    }
+
+    memset(actions, 0, sizeof(int) * inp->num_actions);
+    for(int i = 0; i < INPUT_WORDS; i++) {
+        input_bits bits = q->keys[i];
+        while(bits) {
+            int sc = i * INPUT_WORD_BITS + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            if(inp->key_action[sc] >= 0) actions[inp->key_action[sc]] = 1;
+        }
+    }
+}
+
+void print_input_queue(struct input_queue * q) {
+    printf("input queue: %'8llu key events pushed, %'llu drained, %'llu dropped, max depth %u / %d\n",
+            q->pushed, q->popped, q->dropped, q->max_depth, INPUT_QUEUE_SIZE);
+}
+
+#endif /* STG_INPUTQUEUE_H */
@@ -0,0 +1,216 @@
+#ifndef STG_INSTANCE_H
+#define STG_INSTANCE_H
+
+#include <stdlib.h>
+#include <stddef.h> // offsetof()
+#include <stdio.h>
+#include <string.h>
+
+#include <GL/glew.h>
+
+#include "mat4.h"
+#include "stream.h"
+#include "camera.h"
+#include "glstate.h"
+#include "mesh.h"
+
+/*
+    instanced drawing:
+        one batch per mesh of the mesh library (circle lods are meshes too)
+        per-instance model + color are uploaded to the stream buffer every
+        draw (attrib divisor 1), the attrib pointers are set to wherever the
+        data landed, there is no base instance before gl 4.2
+        the shape is read from the library's vbo + element buffer
+        everything in a batch is drawn with a single glDrawElementsInstanced
+
+    ubo variant (no attrib divisors needed, gl 3.1):
+        a program without a "model" attrib reads the instances from the
+        "objects" block by gl_InstanceID, the batch is uploaded in chunks of
+        INSTANCE_UBO_MAX and every chunk is bound with glBindBufferRange
+        instance_s has the std140 layout of the glsl object_s
+
+    all vertex shaders pass the mesh position as v_local for sdf.h
+*/
+
+const char * instance_vertex_shader_src =
+    "#version 130\n"
+    "uniform mat4 vp;\n"
+    "in vec3 pos;\n"
+    "in mat4 model;\n"
+    "in vec4 color;\n"
+    "out vec4 v_color;\n"
+    "out vec2 v_local;\n"
+    "void main() {\n"
+    "\tv_color = color;\n"
+    "\tv_local = pos.xy;\n"
+    "\tgl_Position = vp * model * vec4(pos, 1.0f);\n"
+    "}\0";
+
+// same, vp from the camera block
+const char * instance_ubo_vertex_shader_src =
+    "#version 140\n"
+    CAMERA_BLOCK_SRC
+    "in vec3 pos;\n"
+    "in mat4 model;\n"
+    "in vec4 color;\n"
+    "out vec4 v_color;\n"
+    "out vec2 v_local;\n"
+    "void main() {\n"
+    "\tv_color = color;\n"
+    "\tv_local = pos.xy;\n"
+    "\tgl_Position = vp * model * vec4(pos, 1.0f);\n"
+    "}\0";
+
+#define INSTANCE_UBO_MAX    128     // * 80 B, stays below the 16 kb minimum block size
+#define INSTANCE_UBO_MAX_STR "128"
+
+const char * object_vertex_shader_src =
+    "#version 140\n"
+    CAMERA_BLOCK_SRC
+    "struct object_s {\n"
+    "\tmat4 model;\n"
+    "\tvec4 color;\n"
+    "};\n"
+    "layout(std140) uniform objects {\n"
+    "\tobject_s obj[" INSTANCE_UBO_MAX_STR "];\n"
+    "};\n"
+    "in vec3 pos;\n"
+    "out vec4 v_color;\n"
+    "out vec2 v_local;\n"
+    "void main() {\n"
+    "\tv_color = obj[gl_InstanceID].color;\n"
+    "\tv_local = pos.xy;\n"
+    "\tgl_Position = vp * obj[gl_InstanceID].model * vec4(pos, 1.0f);\n"
+    "}\0";
+
+const char * instance_fragment_shader_src =
+    "#version 130\n"
+    "in vec4 v_color;\n"
+    "out vec4 fragcolor;\n"
+    "void main() {\n"
+    "\tfragcolor = v_color;\n"
+    "}\0";
+
+struct instance_s {
+    mat4 model;
+    vec4 color;
+};
+typedef struct instance_s instance;
+
+struct instance_batch {
+    GLuint vao;
+    GLenum mode;
+    int first, count; // index range in the mesh library
+    GLint model_loc, color_loc;
+    int ubo;            // instances come from the objects block
+    GLint ubo_align;
+
+    int num, cap;
+    instance * data;
+};
+
+int has_instancing(void) {
+    return (GLEW_VERSION_3_3 || GLEW_ARB_instanced_arrays) &&
+           (GLEW_VERSION_3_1 || GLEW_ARB_draw_instanced);
+}
+
+void init_instance_batch(struct instance_batch * b, GLuint program, struct mesh_library * lib, int mesh) {
+    GLint pos_loc;
+
+    b->mode = lib->meshes[mesh].mode;
+    b->first = lib->meshes[mesh].first;
+    b->count = lib->meshes[mesh].count;
+    b->num = 0;
+    b->cap = 64;
+    b->data = malloc(sizeof(instance) * b->cap);
+
+    pos_loc = glGetAttribLocation(program, "pos");
+    b->model_loc = glGetAttribLocation(program, "model");
+    b->color_loc = glGetAttribLocation(program, "color");
+    b->ubo = b->model_loc < 0;
+    b->ubo_align = 256;
+    if(b->ubo) glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &b->ubo_align);
+
+    glGenVertexArrays(1, &b->vao);
+
+    gls_bind_vertex_array(b->vao);
+
+    // per vertex
+    attach_mesh_library(lib, pos_loc);
+
+    // per instance, a mat4 attrib takes 4 consecutive locations (one per column)
+    // pointers are set by draw_instance_batch()
+    if(!b->ubo) {
+        for(int i = 0; i < 4; i++) {
+            glEnableVertexAttribArray(b->model_loc + i);
+            glVertexAttribDivisor(b->model_loc + i, 1);
+        }
+        glEnableVertexAttribArray(b->color_loc);
+        glVertexAttribDivisor(b->color_loc, 1);
+    }
+
+    gls_bind_vertex_array(0);
+}
+
+void free_instance_batch(struct instance_batch * b) {
+    glDeleteVertexArrays(1, &b->vao);
+    free(b->data);
+    b->data = NULL;
+    b->num = b->cap = 0;
+}
+
+void clear_instance_batch(struct instance_batch * b) {
+    b->num = 0;
+}
+
+// returns a slot for the caller to fill, valid until the next push
+instance * push_instance_batch(struct instance_batch * b) {
+    if(b->num == b->cap) {
+        b->cap *= 2;
+        b->data = realloc(b->data, sizeof(instance) * b->cap);
+    }
+    return &b->data[b->num++];
+}
+
+// objects block, one draw per INSTANCE_UBO_MAX instances
+static int draw_instance_batch_ubo(struct instance_batch * b, struct stream_buffer * sb) {
+    const size_t block = sizeof(instance) * INSTANCE_UBO_MAX;
+    int draws = 0;
+
+    gls_bind_vertex_array(b->vao);
+    for(int i = 0; i < b->num; i += INSTANCE_UBO_MAX) {
+        int n = b->num - i < INSTANCE_UBO_MAX ? b->num - i : INSTANCE_UBO_MAX;
+        size_t offset;
+
+        // the bound range always covers the whole block, only n are used
+        void * dst = map_stream_buffer(sb, block, b->ubo_align, &offset);
+        if(dst) memcpy(dst, b->data + i, sizeof(instance) * n);
+        unmap_stream_buffer(sb);
+
+        gls_bind_buffer_range(GL_UNIFORM_BUFFER, OBJECT_UBO_BINDING, sb->vbo, offset, block);
+        gls_draw_elements_instanced(b->mode, b->count, GL_UNSIGNED_SHORT, sizeof(unsigned short) * b->first, n);
+        draws++;
+    }
+    return draws;
+}
+
+// sb must be between begin_stream_frame() and end_stream_frame(), returns the draw calls
+int draw_instance_batch(struct instance_batch * b, struct stream_buffer * sb) {
+    if(b->num == 0) return 0;
+    if(b->ubo) return draw_instance_batch_ubo(b, sb);
+
+    size_t offset = upload_stream_buffer(sb, b->data, sizeof(instance) * b->num, sizeof(vec4));
+
+    // upload left the stream buffer bound to GL_ARRAY_BUFFER
+    gls_bind_vertex_array(b->vao);
+    for(int i = 0; i < 4; i++) {
+        glVertexAttribPointer(b->model_loc + i, 4, GL_FLOAT, GL_FALSE, sizeof(instance),
+                                (void*)(offset + offsetof(instance, model) + sizeof(float) * 4 * i));
+    }
+    glVertexAttribPointer(b->color_loc, 4, GL_FLOAT, GL_FALSE, sizeof(instance), 
+                            (void*)(offset + offsetof(instance, color)));
+    gls_draw_elements_instanced(b->mode, b->count, GL_UNSIGNED_SHORT, sizeof(unsigned short) * b->first, b->num);
+    return 1;
+}
+
+#endif /* STG_INSTANCE_H */
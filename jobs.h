@@ -0,0 +1,344 @@
+#ifndef STG_JOBS_H
+#define STG_JOBS_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "profile.h"
+
+/*
+    job system:
+        one worker per thread, the main thread is worker 0 and only runs
+        jobs while it waits on a counter
+        every worker owns a deque (chase-lev): the owner pushes / pops at the
+        bottom, everyone else steals from the top, so the common path of a
+        worker running its own jobs has no contention
+        idle workers spin, then yield, then sleep on a condvar until work is pushed
+
+        a job is fn(data, begin, end) over an index range plus a counter that
+        is decremented when it finishes, waiting on the counter is the fence
+            atomic_int c = 0;
+            run_job(js, fn, data, 0, n, &c);
+            wait_job_counter(js, &c);
+        parallel_for() does exactly that for chunks of a range
+
+    jobs are allocated from a per worker ring of JOB_POOL_SIZE, a job slot is
+    reused after JOB_POOL_SIZE more jobs were pushed from the same worker,
+    so no more than that may be in flight per worker
+*/
+
+#define JOB_MAX_THREADS     64
+#define JOB_DEQUE_SIZE      4096    // power of 2
+#define JOB_POOL_SIZE       4096
+
+typedef void (*job_fn)(void * data, int begin, int end);
+
+struct job {
+    job_fn fn;
+    void * data;
+    int begin, end;
+    atomic_int * counter;
+};
+
+struct job_deque {
+    atomic_long top;        // steal end
+    char pad0[64 - sizeof(atomic_long)];
+    atomic_long bottom;     // owner end
+    char pad1[64 - sizeof(atomic_long)];
+    _Atomic(struct job *) buf[JOB_DEQUE_SIZE];
+};
+
+struct job_worker {
+    struct job_deque deque;
+    struct job * pool;
+    unsigned int pool_next;
+    unsigned int rng;       // steal victim
+    struct job_system * js;
+    int index;
+
+    // stats
+    unsigned long long int executed, stolen;
+};
+
+struct job_system {
+    int num_threads;            // running workers incl. the main thread
+    int num_workers;            // allocated, steal range, >= num_threads (failed starts stay, empty)
+    pthread_t threads[JOB_MAX_THREADS];
+    struct job_worker * workers[JOB_MAX_THREADS];
+
+    atomic_int quit;
+    atomic_int queued;          // pushed but not yet taken
+    atomic_int sleepers;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+
+    // totals, summed from the workers by free_job_system()
+    unsigned long long int executed, stolen;
+};
+
+static _Thread_local struct job_worker * job_tls = NULL;
+
+static inline void job_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+/*
+    chase-lev deque, c11 version from
+    "correct and efficient work-stealing for weak memory models" (le et al. 2013)
+    fixed size, a full deque returns 0 and the caller runs the job inline
+*/
+static int push_job_deque(struct job_deque * d, struct job * j) {
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    if(b - t >= JOB_DEQUE_SIZE) return 0;
+
+    atomic_store_explicit(&d->buf[b & (JOB_DEQUE_SIZE - 1)], j, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    return 1;
+}
+
+static struct job * pop_job_deque(struct job_deque * d) {
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&d->top, memory_order_relaxed);
+
+    struct job * j = NULL;
+    if(t <= b) {
+        j = atomic_load_explicit(&d->buf[b & (JOB_DEQUE_SIZE - 1)], memory_order_relaxed);
+        if(t == b) {
+            // last one, race the thieves for it
+            if(!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                        memory_order_seq_cst, memory_order_relaxed)) {
+                j = NULL;
+            }
+            atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        }
+    } else {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+    return j;
+}
+
+static struct job * steal_job_deque(struct job_deque * d) {
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+
+    if(t < b) {
+        struct job * j = atomic_load_explicit(&d->buf[t & (JOB_DEQUE_SIZE - 1)], memory_order_relaxed);
+        if(!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                    memory_order_seq_cst, memory_order_relaxed)) {
+            return NULL; // lost the race
+        }
+        return j;
+    }
+    return NULL;
+}
+
+// own deque first, then steal from a random victim
+static struct job * get_job(struct job_worker * w) {
+    struct job_system * js = w->js;
+    struct job * j = pop_job_deque(&w->deque);
+
+    if(j == NULL && js->num_workers > 1) {
+        w->rng = w->rng * 1664525u + 1013904223u;
+        int start = (w->rng >> 8) % js->num_workers;
+        for(int i = 0; i < js->num_workers && j == NULL; i++) {
+            int v = (start + i) % js->num_workers;
+            if(v == w->index) continue;
+            j = steal_job_deque(&js->workers[v]->deque);
+            if(j) w->stolen++;
+        }
+    }
+
+    if(j) atomic_fetch_sub(&js->queued, 1);
+    return j;
+}
+
+static inline void execute_job(struct job_worker * w, struct job * j) {
+    j->fn(j->data, j->begin, j->end);
+    w->executed++;
+    atomic_fetch_sub_explicit(j->counter, 1, memory_order_release);
+}
+
+static void * job_worker_main(void * arg) {
+    struct job_worker * w = arg;
+    struct job_system * js = w->js;
+    int idle = 0;
+
+    job_tls = w;
+    prof_thread_name("worker");
+
+    while(!atomic_load_explicit(&js->quit, memory_order_relaxed)) {
+        struct job * j = get_job(w);
+        if(j) {
+            execute_job(w, j);
+            idle = 0;
+            continue;
+        }
+
+        // nothing to do: spin a little, yield a little, then sleep
+        idle++;
+        if(idle < 256) {
+            job_relax();
+        } else if(idle < 512) {
+            sched_yield();
+        } else {
+            pthread_mutex_lock(&js->lock);
+            atomic_fetch_add(&js->sleepers, 1);
+            while(!atomic_load(&js->quit) && atomic_load(&js->queued) == 0) {
+                pthread_cond_wait(&js->wake, &js->lock);
+            }
+            atomic_fetch_sub(&js->sleepers, 1);
+            pthread_mutex_unlock(&js->lock);
+            idle = 0;
+        }
+    }
+    return NULL;
+}
+
+static struct job_worker * init_job_worker(struct job_system * js, int index) {
+    struct job_worker * w = aligned_alloc(64, (sizeof(struct job_worker) + 63) / 64 * 64);
+    memset(w, 0, sizeof(struct job_worker));
+    w->js = js;
+    w->index = index;
+    w->rng = 0x9e3779b9u * (index + 1);
+    w->pool = malloc(sizeof(struct job) * JOB_POOL_SIZE);
+    return w;
+}
+
+// threads = workers incl. the calling (main) thread, 1 -> everything runs inline
+void init_job_system(struct job_system * js, int threads) {
+    if(threads < 1) threads = 1;
+    if(threads > JOB_MAX_THREADS) threads = JOB_MAX_THREADS;
+
+    memset(js, 0, sizeof(struct job_system));
+    js->num_threads = threads;
+    js->num_workers = threads;
+    pthread_mutex_init(&js->lock, NULL);
+    pthread_cond_init(&js->wake, NULL);
+
+    for(int i = 0; i < threads; i++) {
+        js->workers[i] = init_job_worker(js, i);
+    }
+    job_tls = js->workers[0];
+
+    for(int i = 1; i < threads; i++) {
+        if(pthread_create(&js->threads[i], NULL, job_worker_main, js->workers[i]) != 0) {
+            // workers 1..i-1 already steal over all of them -> the rest stay
+            // allocated (nothing is ever pushed to them) until free_job_system()
+            printf("jobs: could not start worker %d, running with %d threads\n", i, i);
+            js->num_threads = i;
+            break;
+        }
+    }
+}
+
+void free_job_system(struct job_system * js) {
+    pthread_mutex_lock(&js->lock);
+    atomic_store(&js->quit, 1);
+    pthread_cond_broadcast(&js->wake);
+    pthread_mutex_unlock(&js->lock);
+
+    for(int i = 1; i < js->num_threads; i++) {
+        pthread_join(js->threads[i], NULL);
+    }
+    for(int i = 0; i < js->num_workers; i++) {
+        js->executed += js->workers[i]->executed;
+        js->stolen += js->workers[i]->stolen;
+        free(js->workers[i]->pool);
+        free(js->workers[i]);
+        js->workers[i] = NULL;
+    }
+    pthread_mutex_destroy(&js->lock);
+    pthread_cond_destroy(&js->wake);
+    job_tls = NULL;
+}
+
+// queue fn(data, begin, end), counter is incremented now and decremented when it is done
+void run_job(struct job_system * js, job_fn fn, void * data, int begin, int end, atomic_int * counter) {
+    struct job_worker * w = job_tls;
+    atomic_fetch_add_explicit(counter, 1, memory_order_relaxed);
+
+    if(w == NULL || js->num_threads == 1) {
+        // not a worker thread / no workers
+        fn(data, begin, end);
+        atomic_fetch_sub_explicit(counter, 1, memory_order_release);
+        return;
+    }
+
+    struct job * j = &w->pool[w->pool_next++ & (JOB_POOL_SIZE - 1)];
+    j->fn = fn;
+    j->data = data;
+    j->begin = begin;
+    j->end = end;
+    j->counter = counter;
+
+    atomic_fetch_add(&js->queued, 1);
+    if(!push_job_deque(&w->deque, j)) {
+        atomic_fetch_sub(&js->queued, 1);
+        execute_job(w, j);
+        return;
+    }
+
+    if(atomic_load(&js->sleepers) > 0) {
+        pthread_mutex_lock(&js->lock);
+        pthread_cond_broadcast(&js->wake);
+        pthread_mutex_unlock(&js->lock);
+    }
+}
+
+// runs other jobs until counter hits 0
+void wait_job_counter(struct job_system * js, atomic_int * counter) {
+    struct job_worker * w = job_tls;
+
+    while(atomic_load_explicit(counter, memory_order_acquire) > 0) {
+        struct job * j = w ? get_job(w) : NULL;
+        if(j) {
+            execute_job(w, j);
+        } else {
+            job_relax();
+        }
+    }
+    (void)js;
+}
+
+/*
+    fn over [begin, end) split in chunks of grain, returns when all are done
+    grain <= 0 -> ~4 chunks per thread
+*/
+void parallel_for(struct job_system * js, int begin, int end, int grain, job_fn fn, void * data) {
+    atomic_int counter = 0;
+    int n = end - begin;
+
+    if(n <= 0) return;
+    if(grain <= 0) {
+        grain = n / (js->num_threads * 4);
+        if(grain < 1) grain = 1;
+    }
+    if(js->num_threads == 1 || n <= grain) {
+        fn(data, begin, end);
+        return;
+    }
+
+    for(int i = begin; i < end; i += grain) {
+        run_job(js, fn, data, i, i + grain < end ? i + grain : end, &counter);
+    }
+    wait_job_counter(js, &counter);
+}
+
+// after free_job_system()
+void print_job_system(struct job_system * js) {
+    printf("jobs:       %'9llu executed on %d threads, %'llu stolen\n", 
+            js->executed, js->num_threads, js->stolen);
+}
+
+#endif /* STG_JOBS_H */
@@ -9,8 +9,22 @@
 #include <SDL2/SDL.h>
 
 #include "time.c"
+#include "timing.h"
+#include "profile.h"
 
 #include "mat4.h"
+#include "shader.h"
+#include "instance.h"
+#include "sim.h"
+#include "snakes.h"
+#include "render.h"
+#include "broadphase.h"
+#include "collision.h"
+#include "jobs.h"
+#include "pipeline.h"
+#include "input.h"
+#include "inputlog.h"
+#include "inputqueue.h"
 
 #define A2R		(0.01745329252f)
 
@@ -44,44 +58,8 @@
 
 */
 
-struct render_data_s {
-    int vbo_count, vao_count;
-    int * vbos, * vaos;
-
-    int shader_count;
-    int * shaders;
-
-    // render type (LINE) -> vbo, vao, shader ids map 
-};
-
-// TODO: make timings use a proper timestruct (start, end, elapsed, { ns, us, ms, s, mm, hh, dd, yy }) 
-// along with a nice printout and format function
-
-// for timings
-enum time_tag {
-    TT_INIT = 0, 
-    TT_DEINIT,
-    TT_INPUT,
-    TT_COMPUTE,
-    TT_RENDER,
-    TT_SLEEP,
-
-    TT_MAX
-};
-const char * time_tag_name[TT_MAX] = { "Startup", "Cleanup", "Input", "Update", "Render", "Sleep" };
-
-
-struct shader {
-    int id;
-    char * tag;
-    
-    // map:
-    int loc_count;
-    char * loc_tags;    // key
-    GLuint * locs;      // value
-};
-
 // $ gcc main.c -o build/a.out -lm -lSDL2 -lGL -lGLEW
+// add -march=native (or -mavx) for the avx mat4 batch path, sse is on by default for x86_64
 int main(const int argc, const char ** argv) {
 
     int quit = 0;
@@ -91,11 +69,77 @@ int main(const int argc, const char ** argv) {
     
     // runtime timings
     unsigned long long int total_timing[TT_MAX];
-
-    unsigned long long int max_frame_time, sleep_time; 
+    struct frame_timings frame_timings; // per frame series
+    struct frame_sample_s * fs;
+    int frame_timings_cap;
+    const char * timings_path;
+    const char * trace_path;
+
+    unsigned long long int max_frame_time; 
+    struct frame_pacer frame_pacer;
+    unsigned long long int spin_us; // busy-wait window at the end of the sleep
     float target_fps, frame_delta_time;
 
-    struct render_data_s render_data;
+    float tick_rate; // sim ticks per second, independent of fps
+    struct sim_clock sim_clock;
+    struct sim_state sim_prev, sim_curr, sim_render;
+    int sim_actions[SA_MAX];
+    unsigned long long int prev_frame_start;
+
+    // scene size: snake_count x snake_segments circles
+    int snake_count;
+    int snake_segments;
+    int snake_iterations;   // verlet constraint passes per tick
+    struct snakes snakes;
+    struct broadphase broadphase;
+    struct collide_stats collide_stats;
+
+    struct renderer renderer;
+    int use_instancing;
+    int use_ubo;            // camera + per object data in uniform buffers
+    const char * shader_cache; // program binaries, "" -> off
+    int use_sdf;            // circles as sdf quads
+    int sdf_outline;        // % of the radius
+    int use_gpu_timer;      // gpu time per render pass in the frame series
+    int res_w, res_h;       // internal resolution, the window is letterboxed around it
+    int use_dynres;
+    unsigned long long int render_budget_us; // dynres target for TT_RENDER, 0 -> half a frame
+
+    // bench: fixed number of frames, no pacing, one sim tick per frame
+    unsigned long long int bench_frames;
+    int headless;           // update only, no SDL / GL at all
+
+    // update jobs, main thread + workers
+    int num_threads;
+    struct job_system jobs;
+    int scaling_ticks;      // > 0 -> thread scaling benchmark and exit
+
+    // update of frame N overlaps the render of frame N - 1
+    int pipelined;
+    struct update_s update;
+    struct render_snapshot snapshots[2];
+    atomic_int update_counter = 0;
+    unsigned long long int input_us, shown_input_us;
+    unsigned long long int key_us, shown_key_us;    // first key event of the input, sdl timestamp
+    unsigned long long int key_after_swap = 0;      // key stamped after the swap (ms rounding), no sample
+
+    // sleep before the input instead of after the swap, re-latch the turn before the draw
+    int late_input;
+    // key events from an sdl event watch, drained by the sim per tick
+    int use_event_queue;
+    struct input_queue input_queue;
+    int latch_actions[SA_MAX];
+    unsigned long long int latched_frames = 0;
+    unsigned long long int pipeline_wait_us = 0;
+    const char * bench_path;
+
+    // input log, replay drives the sim from a recorded session
+    struct input_log input_log;
+    const char * record_path;
+    const char * replay_path;
+    float replay_speed;     // x real time, 0 -> as fast as possible
+    int replaying;
+    unsigned int sim_hash;
 
     SDL_Event sdl_event;
     SDL_version sdl_ver_compiled, sdl_ver_linked;
@@ -111,6 +155,39 @@ int main(const int argc, const char ** argv) {
     // load default values:
     frame_count = 0;
     target_fps = 60.0f;
+    tick_rate = 60.0f;
+    spin_us = 250;
+    snake_count = 1;
+    snake_segments = 9;
+    snake_iterations = 4;
+    use_instancing = 1;
+    use_ubo = 1;
+    shader_cache = "shader_cache";
+    use_sdf = 1;
+    sdf_outline = 0;
+    use_gpu_timer = 1;
+    res_w = 640;
+    res_h = 480;
+    use_dynres = 0;
+    render_budget_us = 0;
+    bench_frames = 0;
+    headless = 0;
+    num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if(num_threads < 1) num_threads = 1;
+    if(num_threads > JOB_MAX_THREADS) num_threads = JOB_MAX_THREADS;
+    scaling_ticks = 0;
+    pipelined = 0;
+    late_input = 0;
+    use_event_queue = 0;
+    bench_path = NULL;
+    record_path = NULL;
+    replay_path = NULL;
+    replay_speed = 1.0f;
+    replaying = 0;
+    input_log.mode = 0;
+    frame_timings_cap = FRAME_TIMINGS_DEFAULT_CAP;
+    timings_path = NULL;
+    trace_path = NULL;
     
     // check if stdout is terminal or not (running from terminal) 
     if(!isatty(1)) {
@@ -123,6 +200,7 @@ int main(const int argc, const char ** argv) {
     // handle argv
     {
         int in_fps = 0;
+        int in_val = 0;
         int i = 1;
         int arglen = 0;
         const char * arg = NULL;
@@ -131,7 +209,7 @@ int main(const int argc, const char ** argv) {
             arg = argv[i];
             if(arg != NULL) {
                 arglen = strlen(arg);
-                if(memcmp(arg, "-fps=", 5)) {
+                if(!memcmp(arg, "-fps=", 5)) {
                     // matches
                     in_fps = atoi(arg + 5);
                     if(in_fps > 0) {
@@ -140,475 +218,403 @@ int main(const int argc, const char ** argv) {
                     } else {
                         printf("arg: [%s] value %d is not allowed\n", arg, in_fps);
                     }
+                } else if(!memcmp(arg, "-tickrate=", 10)) {
+                    in_val = atoi(arg + 10);
+                    if(in_val > 0 && in_val <= SIM_MAX_TICK_RATE) {
+                        printf("arg: tickrate = %d\n", in_val);
+                        tick_rate = (float)in_val;
+                    } else {
+                        printf("arg: [%s] value %d is not allowed\n", arg, in_val);
+                    }
+                } else if(!memcmp(arg, "-spin_us=", 9)) {
+                    in_val = atoi(arg + 9);
+                    if(in_val >= 0) {
+                        printf("arg: spin_us = %d\n", in_val);
+                        spin_us = in_val;
+                    } else {
+                        printf("arg: [%s] value %d is not allowed\n", arg, in_val);
+                    }
+                } else if(!memcmp(arg, "-snakes=", 8)) {
+                    in_val = atoi(arg + 8);
+                    if(in_val > 0) {
+                        printf("arg: snakes = %d\n", in_val);
+                        snake_count = in_val;
+                    } else {
+                        printf("arg: [%s] value %d is not allowed\n", arg, in_val);
+                    }
+                } else if(!memcmp(arg, "-bench=", 7)) {
+                    in_val = atoi(arg + 7);
+                    if(in_val > 0) {
+                        printf("arg: bench = %d frames\n", in_val);
+                        bench_frames = in_val;
+                    } else {
+                        printf("arg: [%s] value %d is not allowed\n", arg, in_val);
+                    }
+                } else if(!memcmp(arg, "-bench_out=", 11)) {
+                    bench_path = arg + 11;
+                    printf("arg: bench_out = %s\n", bench_path);
+                } else if(!memcmp(arg, "-threads=", 9)) {
+                    in_val = atoi(arg + 9);
+                    if(in_val > 0 && in_val <= JOB_MAX_THREADS) {
+                        printf("arg: threads = %d\n", in_val);
+                        num_threads = in_val;
+                    } else {
+                        printf("arg: [%s] value %d is not allowed\n", arg, in_val);
+                    }
+                } else if(!memcmp(arg, "-scaling=", 9)) {
+                    in_val = atoi(arg + 9);
+                    if(in_val > 0) {
+                        printf("arg: scaling = %d ticks\n", in_val);
+                        scaling_ticks = in_val;
+                    } else {
+                        printf("arg: [%s] value %d is not allowed\n", arg, in_val);
+                    }
+                } else if(!strcmp(arg, "-pipelined")) {
+                    printf("arg: pipelined\n");
+                    pipelined = 1;
+                } else if(!strcmp(arg, "-late_input")) {
+                    printf("arg: late_input\n");
+                    late_input = 1;
+                } else if(!memcmp(arg, "-event_queue=", 13)) {
+                    use_event_queue = atoi(arg + 13) != 0;
+                    printf("arg: event_queue = %d\n", use_event_queue);
+                } else if(!strcmp(arg, "-headless")) {
+                    printf("arg: headless\n");
+                    headless = 1;
+                } else if(!memcmp(arg, "-segments=", 10)) {
+                    in_val = atoi(arg + 10);
+                    if(in_val > 0) {
+                        printf("arg: segments = %d\n", in_val);
+                        snake_segments = in_val;
+                    } else {
+                        printf("arg: [%s] value %d is not allowed\n", arg, in_val);
+                    }
+                } else if(!memcmp(arg, "-iterations=", 12)) {
+                    in_val = atoi(arg + 12);
+                    if(in_val > 0) {
+                        printf("arg: iterations = %d\n", in_val);
+                        snake_iterations = in_val;
+                    } else {
+                        printf("arg: [%s] value %d is not allowed\n", arg, in_val);
+                    }
+                } else if(!memcmp(arg, "-timings=", 9)) {
+                    // export per frame timings at exit (.json or .csv)
+                    timings_path = arg + 9;
+                    printf("arg: timings = %s\n", timings_path);
+                } else if(!memcmp(arg, "-trace=", 7)) {
+                    // chrome://tracing / perfetto json of the profile zones at exit
+                    trace_path = arg + 7;
+                    printf("arg: trace = %s\n", trace_path);
+                } else if(!memcmp(arg, "-timing_frames=", 15)) {
+                    in_val = atoi(arg + 15);
+                    if(in_val > 0) {
+                        printf("arg: timing_frames = %d\n", in_val);
+                        frame_timings_cap = in_val;
+                    } else {
+                        printf("arg: [%s] value %d is not allowed\n", arg, in_val);
+                    }
+                } else if(!memcmp(arg, "-res=", 5)) {
+                    // WxH
+                    const char * sep = strchr(arg + 5, 'x');
+                    int w = atoi(arg + 5);
+                    int h = sep ? atoi(sep + 1) : 0;
+                    if(w > 0 && h > 0) {
+                        printf("arg: res = %dx%d\n", w, h);
+                        res_w = w;
+                        res_h = h;
+                    } else {
+                        printf("arg: [%s] value is not allowed, expected WxH\n", arg);
+                    }
+                } else if(!strcmp(arg, "-dynres")) {
+                    printf("arg: dynres\n");
+                    use_dynres = 1;
+                } else if(!memcmp(arg, "-render_budget_us=", 18)) {
+                    in_val = atoi(arg + 18);
+                    if(in_val > 0) {
+                        printf("arg: render_budget_us = %d\n", in_val);
+                        render_budget_us = in_val;
+                    } else {
+                        printf("arg: [%s] value %d is not allowed\n", arg, in_val);
+                    }
+                } else if(!memcmp(arg, "-instanced=", 11)) {
+                    use_instancing = atoi(arg + 11) != 0;
+                    printf("arg: instanced = %d\n", use_instancing);
+                } else if(!memcmp(arg, "-shader_cache=", 14)) {
+                    shader_cache = arg + 14;
+                    printf("arg: shader_cache = %s\n", *shader_cache ? shader_cache : "off");
+                } else if(!memcmp(arg, "-sdf=", 5)) {
+                    use_sdf = atoi(arg + 5) != 0;
+                    printf("arg: sdf = %d\n", use_sdf);
+                } else if(!memcmp(arg, "-sdf_outline=", 13)) {
+                    in_val = atoi(arg + 13);
+                    if(in_val >= 0 && in_val <= 100) {
+                        printf("arg: sdf_outline = %d%%\n", in_val);
+                        sdf_outline = in_val;
+                    } else {
+                        printf("arg: [%s] value %d is not allowed\n", arg, in_val);
+                    }
+                } else if(!memcmp(arg, "-gpu_timer=", 11)) {
+                    use_gpu_timer = atoi(arg + 11) != 0;
+                    printf("arg: gpu_timer = %d\n", use_gpu_timer);
+                } else if(!memcmp(arg, "-record=", 8)) {
+                    record_path = arg + 8;
+                    printf("arg: record = %s\n", record_path);
+                } else if(!memcmp(arg, "-replay=", 8)) {
+                    replay_path = arg + 8;
+                    printf("arg: replay = %s\n", replay_path);
+                } else if(!memcmp(arg, "-replay_speed=", 14)) {
+                    float in_speed = atof(arg + 14);
+                    if(in_speed >= 0.0f) {
+                        printf("arg: replay_speed = %.2f%s\n", in_speed, in_speed > 0.0f ? "" : " (as fast as possible)");
+                        replay_speed = in_speed;
+                    } else {
+                        printf("arg: [%s] value %.2f is not allowed\n", arg, in_speed);
+                    }
+                } else if(!memcmp(arg, "-ubo=", 5)) {
+                    use_ubo = atoi(arg + 5) != 0;
+                    printf("arg: ubo = %d\n", use_ubo);
+                } else {
+                    printf("arg: [%s] unknown\n", arg);
                 }
             }
             i++;
         }
     }
 
-    // calc normal values:
-    frame_delta_time = 1.0f / target_fps;
-    max_frame_time = (unsigned long long int)(frame_delta_time * 1000 * 1000);
-
-    
-
-    // do rest of init:
-    printf("hello world!\n");
-
-    printf("init SDL\n");
-    SDL_Init(SDL_INIT_EVERYTHING);
-
-    SDL_VERSION(&sdl_ver_compiled);
-    SDL_GetVersion(&sdl_ver_linked);
-
-    printf("* compiled against SDL version %u.%u.%u\n", 
-            sdl_ver_compiled.major, sdl_ver_compiled.minor, sdl_ver_compiled.patch);
-
-    printf("* linked against SDL version %u.%u.%u\n", 
-            sdl_ver_linked.major, sdl_ver_linked.minor, sdl_ver_linked.patch);
-
-    printf("create SDL window\n");
-    unsigned int window_flags = SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE;
-    window = SDL_CreateWindow("title", 
-                            SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-                            640, 480, window_flags); 
-
-    printf("create GL context\n");
-    context = SDL_GL_CreateContext(window);
-    // v-sync with monitor refresh rate
-	SDL_GL_SetSwapInterval(0); // disable vsync for N-fps
-
-    // set GL attributes for api
-    SDL_GL_SetAttribute (SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
-	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
-	SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 16); // 24
-
-    // SDL_GL_SetAttribute(SDL_GL_ACCELERATED_VISUAL, 1); // option
-
-    // init glew (gl bindings)
-    glewInit();
-	glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS);
-
-    printf ("glGetString (GL_VERSION) returns %s\n", glGetString (GL_VERSION));
-
-    // actually situationally dependant (diff between see-through models)
-    glFrontFace(GL_CCW);
-    glEnable(GL_CULL_FACE);
-    glCullFace(GL_BACK);
-
-	glEnable(GL_TEXTURE_2D);
-
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-    // glViewport(0, 0, 640, 480);
-
-    vec4 background_color;
-    vec4 field_color;
-    vec4 snake_color;
-    vec4 snake_eye_color;
-    vec4 player_color;
-
-    set_rgb_vec4(173, 216, 230, &background_color); // light sky blue
-    set_rgb_vec4(58, 191, 91, &field_color); // dark field green
-    set_rgb_vec4(41, 41, 41, &snake_color); // blue dark snake
-    set_rgb_vec4(255, 35, 22, &snake_eye_color); // vivid red
-    set_rgb_vec4(250, 253, 248, &player_color); // light bone
-
-    // red backgroud
-    glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
-    {
-        float r, g, b;
-        
-        // light sky blue
-        r = 173.0f / 255.0f;
-        g = 216.0f / 255.0f;
-        b = 230.0f / 255.0f;
-
-        // light field green
-        r = 114.0f / 255.0f;
-        g = 212.0f / 255.0f;
-        b = 138.0f / 255.0f;
-
-        // dark field green
-        r = 58.0f / 255.0f;
-        g = 191.0f / 255.0f;
-        b = 91.0f / 255.0f;
-
-        // dark snake
-        r = 4.0f / 255.0f;
-        g = 14.0f / 255.0f;
-        b = 7.0f / 255.0f;
-
-        // blue dark snake
-        r = 17.0f / 255.0f;
-        g = 25.0f / 255.0f;
-        b = 27.0f / 255.0f;
-
-        // vivid red
-        r = 255.0f / 255.0f;
-        g = 35.0f / 255.0f;
-        b = 22.0f / 255.0f;
-
-        // vivid yellow
-        r = 255.0f / 255.0f;
-        g = 210.0f / 255.0f;
-        b = 22.0f / 255.0f;
-
-        glClearColor(r, g, b, 1.0f);
+    if(headless && !bench_frames) {
+        // nothing would ever quit the loop
+        printf("arg: -headless needs -bench=N, using 1000 frames\n");
+        bench_frames = 1000;
     }
 
-    glClearColor(background_color.x, background_color.y, background_color.z, background_color.w);
-
-    printf("* compile line shader\n");
-    
-    // make a separete rendering module for the opengl info.
-    GLuint line_vao, line_vbo, line_shader;
-    GLuint line_shader_mvp_loc; //, proj_loc, view_loc; 
-    GLuint line_shader_color_loc;
-    
-    int circle_first_index = 0;
-    int circle_last_index = 0;
-
-    {
-        // does not work on my pc -> needs newer opengl version
-        #if 0
-        const char * line_vertex_shader_src = 
-            "#version 330 core\n"
-            "layout (location = 0) in vec3 pos;\n"
-            "uniform mat4 proj;\n"
-            "uniform mat4 view;\n"            
-            "void main() { \n"
-            "\tmat4 mvp = view * proj;\n"
-            "\tgl_Position = mvp * vec4(pos, 1.0f);\n"
-            "}\0";
-            // "uniform mat4 mvp;\n"
-
-        const char * line_fragment_shader_src = 
-            "#version 330 core\n"
-            "out vec4 fragcolor;\n"
-            "uniform vec3 color;\n"
-            "void main() { \n"
-            "\tfragcolor = vec4(color, 1.0f);\n"
-            "}\0";
-        #else
-
-        const char * line_vertex_shader_src = 
-            "#version 130\n"
-            "uniform mat4 mvp;\n"
-            "in vec3 pos;\n"
-            "void main() {\n"
-            "\tgl_Position = mvp * vec4(pos, 1.0f);\n"
-            "}\0";
-
-        const char * line_fragment_shader_src = 
-            "#version 130\n"
-            "uniform vec3 color;\n"
-            "out vec4 fragcolor;\n"
-            "void main() {\n"
-            "\tfragcolor = vec4(color, 1.0f);\n"
-            "}\0";
-        #endif
-    
-        int vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex_shader, 1, &line_vertex_shader_src, NULL);
-        glCompileShader(vertex_shader);
-        // check for errors etc
-        GLint status;
-        glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &status);
-        if(status == GL_FALSE )
-        {
-            char buf[1024];
-            GLint logLen;
-            glGetShaderiv( vertex_shader, GL_INFO_LOG_LENGTH, &logLen );
-            GLsizei written;
-            glGetShaderInfoLog( vertex_shader, logLen, &written, buf);
-            printf("vs: comp err: %s\n", buf);
-        }
-
-        int fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment_shader, 1, &line_fragment_shader_src, NULL);
-        glCompileShader(fragment_shader);
-
-        glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &status);
-        if(status == GL_FALSE )
-        {
-            char buf[1024];
-            GLint logLen;
-            glGetShaderiv( fragment_shader, GL_INFO_LOG_LENGTH, &logLen );
-            GLsizei written;
-            glGetShaderInfoLog( fragment_shader, logLen, &written, buf );
-            printf("fs: comp err: %s\n", buf);
-        }
-
-
-        // link to shader program
-        int shader_program = glCreateProgram();
-        // glBindAttribLocation(shader_program, 0, "pos");
-
-        glAttachShader(shader_program, vertex_shader);
-        glAttachShader(shader_program, fragment_shader);
-        glLinkProgram(shader_program);
-        // check linkage error etc
-        glGetProgramiv( shader_program, GL_LINK_STATUS, &status );
-        if ( status == GL_FALSE )
-        {
-            char buf[1024];
-            GLint logLen;
-            glGetProgramiv( shader_program, GL_INFO_LOG_LENGTH, &logLen );
-            GLsizei written;
-            glGetProgramInfoLog( shader_program, logLen, &written, buf );
-            printf("link err: %s\n", buf);
-        }
-        glValidateProgram(shader_program);
-        glGetProgramiv(shader_program, GL_VALIDATE_STATUS, &status);
-        if (!status) {
-            char buf[1024];
-            GLint logLen;
-            glGetProgramiv( shader_program, GL_INFO_LOG_LENGTH, &logLen );
-            GLsizei written;
-            glGetProgramInfoLog( shader_program, logLen, &written, buf );
-            printf("link valid err: %s\n", buf);
-        }
-
-        glDeleteShader(vertex_shader);
-        glDeleteShader(fragment_shader);
-
-        line_shader = shader_program;
-        glUseProgram(line_shader);
-
-        // gen space
-        glGenVertexArrays(1, &line_vao);
-        glGenBuffers(1, &line_vbo);
-
-        // bind for usage
-        glBindVertexArray(line_vao);
-        glBindBuffer(GL_ARRAY_BUFFER, line_vbo);
-
-        float * verts = malloc(sizeof(float) * (3 * 1024));
-
-        // push data once
-        int num_vertices = 3 * (3 + 6);
-        float vertices[] = {
-            // triangle is not oriented toward 0.
-            // 0..3 triangle
-            /*
-            -0.5f, -0.5f, 0.0f,
-             0.5f, -0.5f, 0.0f,
-             0.0f,  0.5f, 0.0f,
-            */
-    
-            // player 0 oriented triangle
-            0.5f, 0.0f, 0.0f,
-            -0.5f, 0.5f, 0.0f, 
-            -0.5f, -0.5f, 0.0f,
-
-            // 3..9 rectangle
-            -0.5f,  0.5f, 0.0f,
-            -0.5f, -0.5f, 0.0f,
-             0.5f,  0.5f, 0.0f,
-             0.5f,  0.5f, 0.0f,
-            -0.5f, -0.5f, 0.0f,
-             0.5f, -0.5f, 0.0f,
-        };
-
-        memcpy(verts, vertices, sizeof(float) * num_vertices);
-
-        circle_first_index = num_vertices / 3;
-        // gen circle & push
-        {
-            float * ptr = verts + num_vertices;
-            float radius = 0.5;
-            
-            int points = 12;
-            float angle = 360.0f / points;
-
-            float ax = angle; // delta
-            for(int i = 0; i < points; i++) {
-                *ptr++ = 0.0f;
-                *ptr++ = 0.0f;
-                *ptr++ = 0.0f;
-
-                *ptr++ = cos(A2R * angle) * radius;
-                *ptr++ = sin(A2R * angle) * radius;
-                *ptr++ = 0.0f;
-
-                angle += ax;
-
-                *ptr++ = cos(A2R * angle) * radius;
-                *ptr++ = sin(A2R * angle) * radius;
-                *ptr++ = 0.0f;
+    if(replay_path != NULL) {
+        // the recorded scene, else the replay can not end on the same state
+        struct input_log_header header;
+        if(open_input_log(&input_log, replay_path, IL_REPLAY, &header)) {
+            printf("replay: %s, %d snakes x %d segments, %d iterations, tick %d us\n", replay_path,
+                    header.snake_count, header.snake_segments, header.snake_iterations, header.tick_us);
+            snake_count = header.snake_count;
+            snake_segments = header.snake_segments;
+            snake_iterations = header.snake_iterations;
+            replaying = 1;
+            if(record_path != NULL) {
+                printf("replay: not recording while replaying\n");
+                record_path = NULL;
             }
-
-            num_vertices += points * 9;
-            circle_last_index = num_vertices; 
         }
+    }
 
-        glBufferData(GL_ARRAY_BUFFER, sizeof(float) * num_vertices, verts, GL_STATIC_DRAW);
-
-        free(verts);
-
-
+    // calc normal values:
+    frame_delta_time = 1.0f / target_fps;
+    max_frame_time = (unsigned long long int)(frame_delta_time * 1000 * 1000);
+    if(render_budget_us == 0) render_budget_us = max_frame_time / 2;
+
+    // zones are only recorded when a trace was asked for
+    prof_init(trace_path != NULL);
+    prof_thread_name("main"); // before the workers grab the first slot
+
+    // snake update throughput for 1, 2, 4 .. -threads= threads, then exit
+    if(scaling_ticks) {
+        double base_rate = 0.0;
+        int t = 1;
+
+        printf("\nscaling: %d snakes x %d segments, %d iterations, %d ticks\n", 
+                snake_count, snake_segments, snake_iterations, scaling_ticks);
+        printf("  %7s %12s %8s %8s\n", "threads", "segments/ms", "speedup", "eff");
+        while(1) {
+            init_job_system(&jobs, t);
+            init_snakes(&snakes, snake_count, snake_segments, 1234);
+            snakes.iterations = snake_iterations;
+
+            unsigned long long int t0 = get_time_ns();
+            for(int i = 0; i < scaling_ticks; i++) {
+                tick_snakes_parallel(&snakes, 1.0f / 60.0f, &jobs);
+            }
+            unsigned long long int ns = get_time_ns() - t0;
 
-        // setup how data is read and enable it
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
+            double rate = (double)snake_count * snake_segments * scaling_ticks / (ns / 1000000.0);
+            if(t == 1) base_rate = rate;
+            printf("  %7d %'12.0f %7.2fx %7.0f%%\n", jobs.num_threads, rate, rate / base_rate, 
+                    100.0 * rate / base_rate / jobs.num_threads);
+            fprintf(stderr, "{\"threads\":%d,\"snakes\":%d,\"segments\":%d,\"iterations\":%d,"
+                            "\"ticks\":%d,\"segments_per_ms\":%.1f}\n",
+                    jobs.num_threads, snake_count, snake_segments, snake_iterations, scaling_ticks, rate);
 
-        line_shader_mvp_loc = glGetUniformLocation(line_shader, "mvp");
-        line_shader_color_loc = glGetUniformLocation(line_shader, "color");
+            free_snakes(&snakes);
+            free_job_system(&jobs);
 
-        // unbind 
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
-        glUseProgram(0);
+            if(t >= num_threads) break;
+            t = t * 2 < num_threads ? t * 2 : num_threads;
+        }
 
-        printf("shader comp complete\n");
+        free_profile();
+        return 0;
     }
+    prof_begin(time_tag_name[TT_INIT]);
 
-    #if 0
-    // https://learnopengl.com/Advanced-OpenGL/Framebuffers
-
-    // note: to use fbo and fbo_tex we need a special shader to draw to the screen with!
-    // that means that we can do special post-processing on the entire rendered scene
+    // do rest of init:
+    printf("hello world!\n");
 
-    // framebuffer
-    printf("gen fbo\n");
-    GLuint fbo, fbo_tex;
-    glGenFramebuffers(1, &fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) {
-        printf("fbo ok\n");
+    if(headless) {
+        printf("headless: no SDL / GL, update only\n");
+        window = NULL;
+        context = NULL;
+    } else {
+        printf("init SDL\n");
+        prof_begin("SDL_Init");
+        SDL_Init(SDL_INIT_EVERYTHING);
+        prof_end();
+
+        SDL_VERSION(&sdl_ver_compiled);
+        SDL_GetVersion(&sdl_ver_linked);
+
+        printf("* compiled against SDL version %u.%u.%u\n", 
+                sdl_ver_compiled.major, sdl_ver_compiled.minor, sdl_ver_compiled.patch);
+
+        printf("* linked against SDL version %u.%u.%u\n", 
+                sdl_ver_linked.major, sdl_ver_linked.minor, sdl_ver_linked.patch);
+
+        printf("create SDL window\n");
+        prof_begin("create window + context");
+        unsigned int window_flags = SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE;
+        if(bench_frames) window_flags |= SDL_WINDOW_HIDDEN; // draws still happen, offscreen
+        window = SDL_CreateWindow("title", 
+                                SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+                                640, 480, window_flags); 
+
+        printf("create GL context\n");
+        context = SDL_GL_CreateContext(window);
+        // v-sync with monitor refresh rate
+    	SDL_GL_SetSwapInterval(0); // disable vsync for N-fps
+
+        // set GL attributes for api
+        SDL_GL_SetAttribute (SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+    	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+    	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+    	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+    	SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 16); // 24
+
+        // SDL_GL_SetAttribute(SDL_GL_ACCELERATED_VISUAL, 1); // option
+
+        prof_end();
+
+        // init glew (gl bindings)
+        prof_begin("glewInit");
+        glewInit();
+        prof_end();
+
+        printf ("glGetString (GL_VERSION) returns %s\n", glGetString (GL_VERSION));
+
+        struct render_options render_opts;
+        render_opts.instancing = use_instancing;
+        render_opts.ubo = use_ubo;
+        render_opts.w = res_w;
+        render_opts.h = res_h;
+        render_opts.shader_cache = shader_cache;
+        render_opts.sdf = use_sdf;
+        render_opts.sdf_outline = sdf_outline;
+        render_opts.gpu_timer = use_gpu_timer;
+        init_renderer(&renderer, &render_opts);
+        // without an fbo the view can not be scaled
+        init_dynres(&renderer.dynres, use_dynres && renderer.target.fbo, render_budget_us);
     }
-    
-    // use a simple color texture without depth for fbo
-    glGenTextures(1, &fbo_tex);
-    glBindTexture(GL_TEXTURE_2D, fbo_tex);
-    
-    // RGB888
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 320, 240, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    
-    // attach tex to fbo
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fbo_tex, 0);
-    #endif
-    
-    
-    vec3 p_pos;
-    vec3 p_vel;
-    vec3 p_rot;
 
-    set_vec3(3.0f, 3.0f, -3.8f, &p_pos);
-    set_vec3(0.0f, 0.0f, 0.0f, &p_vel);
-    set_vec3(0.0f, 0.0f, A2R * -90.0f, &p_rot);
+    init_sim_clock(&sim_clock, tick_rate, 5);
+    if(replaying) {
+        // exact tick, tick_rate would round
+        sim_clock.tick_us = input_log.header.tick_us;
+        sim_clock.dt = (float)sim_clock.tick_us / 1000000.0f;
+    }
+    init_sim_state(&sim_curr);
+    init_snakes(&snakes, snake_count, snake_segments, 1234);
+    snakes.iterations = snake_iterations;
+    init_broadphase(&broadphase, 1.0f);
+    init_job_system(&jobs, num_threads);
+    memset(&collide_stats, 0, sizeof(struct collide_stats));
+    sim_prev = sim_curr;
+    sim_render = sim_curr;
+
+    update.clock = &sim_clock;
+    update.prev = &sim_prev;
+    update.curr = &sim_curr;
+    update.render = &sim_render;
+    update.snakes = &snakes;
+    update.bp = &broadphase;
+    update.stats = &collide_stats;
+    update.js = &jobs;
+    update.out = NULL;
+    update.replay = replaying ? &input_log : NULL;
+    update.alpha = 0.0f;
+    if(pipelined) {
+        init_render_snapshot(&snapshots[0], &snakes);
+        init_render_snapshot(&snapshots[1], &snakes);
+        // what frame 0 draws, no input behind it -> no latency sample
+        fill_render_snapshot(&snapshots[1], &sim_render, &snakes, 0.0f, 0, 0, 0);
+    }
     
 
+    prof_end();
     end = get_time_us();
     elapsed = end - start;
     total_timing[TT_INIT] = elapsed;
 
-    // cam movement
-    float dx = 0.0f;
-    float dy = 1.0f;
-    float c_force_x = 8.0f;
-    float c_force_y = 8.0f;
-    float vel_x, vel_y;
+    // TODO: add copy of the map during mapping so that you then can APPLY or DISCARD changes. (can also mask changes)
 
-    float p_rot_z = 0.0f;
-    float p_x = 0.0f;
-    float p_y = 0.0f;
+    // keys -> sim actions, remappable with q
+    struct input input;
+    init_input(&input, SA_MAX);
+    bind_input(&input, SDL_SCANCODE_LEFT, SA_LEFT);
+    bind_input(&input, SDL_SCANCODE_RIGHT, SA_RIGHT);
+    bind_input(&input, SDL_SCANCODE_DOWN, SA_DOWN);
+    bind_input(&input, SDL_SCANCODE_UP, SA_UP);
+    bind_input(&input, SDL_SCANCODE_SPACE, SA_FIRE);
+
+    unsigned long long int frame_start, frame_end, frame_late;
+
+    if(record_path != NULL) {
+        struct input_log_header header;
+        header.tick_us = sim_clock.tick_us;
+        header.num_actions = SA_MAX;
+        header.snake_count = snake_count;
+        header.snake_segments = snake_segments;
+        header.snake_iterations = snake_iterations;
+        open_input_log(&input_log, record_path, IL_RECORD, &header);
+    }
 
-    // TODO: remappable keys
-    // TODO: keylogger and replayer 
-    // TODO: separete modules for the remapper and keylogger (always live but only fires if needed)
-    // TODO: add copy of the map during mapping so that you then can APPLY or DISCARD changes. (can also mask changes)
+    // the sim takes its keys per tick from the event watch, the main loop reads them for remapping / quit
+    update.input = &input;
+    update.queue = NULL;
+    if(use_event_queue && !headless) {
+        init_input_queue(&input_queue);
+        attach_input_queue(&input_queue);
+        update.queue = &input_queue;
+    }
+    update.input_blocked = 0;
+    update.record = input_log.mode == IL_RECORD ? &input_log : NULL;
 
-    struct input_key {
-        // int tag; // action key map
-        long int keysym;
-        int value;
-    };
-
-    struct index_map {
-        int from;
-        int to;
-    };
-
-    struct input_action_key {
-        int tag;
-        union {
-            int i;
-            float f;
-        } value;
-    };
-
-    int is_remapping = 0;
-    int im_index = -1;
-    struct index_map c_im_kb;
-
-    int                     in_kb[SDL_NUM_SCANCODES]; 
-    struct index_map        im_kb[4];
-    struct input_action_key iak[4]; // keep one per frame
-
-    int                     in_kb_prev[SDL_NUM_SCANCODES];
-    struct index_map        im_kb_prev[4];
-    struct input_action_key iak_prev[4]; 
-
-    memset(in_kb, 0, sizeof(int) * SDL_NUM_SCANCODES);
-    memset(in_kb_prev, 0, sizeof(int) * SDL_NUM_SCANCODES);
-
-    im_kb[0].from = SDL_SCANCODE_LEFT;
-    im_kb[0].to = 0;
-    im_kb[1].from = SDL_SCANCODE_RIGHT;
-    im_kb[1].to = 1;
-    im_kb[2].from = SDL_SCANCODE_DOWN;
-    im_kb[2].to = 2;
-    im_kb[3].from = SDL_SCANCODE_UP;
-    im_kb[3].to = 3;
-
-    c_im_kb.from = -1;
-    c_im_kb.to = -1;
-
-    memset(iak, 0, sizeof(struct input_action_key) * 4);
-    memset(iak_prev, 0, sizeof(struct input_action_key) * 4);
-    iak[0].tag = 0;
-    iak[1].tag = 1;
-    iak[2].tag = 2;
-    iak[3].tag = 3;
-
-    unsigned long long int frame_start, frame_end, frame_elapsed;
-
-    long int scancode;
-    long int keysym;
+    init_frame_timings(&frame_timings, frame_timings_cap);
 
     // make sure that we dont drop frames by aligning to the v-sync (if on)
     // * can we wait until the window is mapped?
-    SDL_GL_SwapWindow(window);
+    if(!headless) SDL_GL_SwapWindow(window);
+    prev_frame_start = get_time_us() - sim_clock.tick_us;
+    init_frame_pacer(&frame_pacer, max_frame_time * 1000, spin_us * 1000);
 
     while(!quit) {
         frame_start = get_time_us();
-    
-        // ok        
-        vel_x = 0.0f;
-        vel_y = 0.0f;
+        fs = push_frame_timings(&frame_timings, frame_count);
+        prof_begin(time_tag_name[TT_INPUT]);
 
-        memcpy(in_kb_prev, in_kb, sizeof(int) * SDL_NUM_SCANCODES);
-        memcpy(iak_prev, iak, sizeof(struct input_action_key) * 4);
+        begin_input_frame(&input);
+        if(!headless) sync_input_clock(&input, get_time_us());
 
         start = frame_start;
         // read input:
-        while(SDL_PollEvent(&sdl_event) != 0) {
+        while(!headless && SDL_PollEvent(&sdl_event) != 0) {
 		    switch(sdl_event.type) {
-                 case SDL_KEYDOWN: {
-                    scancode = sdl_event.key.keysym.scancode;
-                    in_kb[scancode] = 1;
-                } break;
+                case SDL_KEYDOWN:
                 case SDL_KEYUP: {
-                    scancode = sdl_event.key.keysym.scancode;
-                    in_kb[scancode] = 0;
+                    input_event(&input, &sdl_event);
                 } break;
 			    case SDL_QUIT: {
 				    printf("cmd: sdl_window_quit\n");
@@ -616,317 +622,189 @@ int main(const int argc, const char ** argv) {
 			    } break;
 		    }
 	    }
-        
-        // TODO: move mapping to separete module!
-        if(in_kb[SDL_SCANCODE_Q] && !in_kb_prev[SDL_SCANCODE_Q]) { // hacky inital check
-            is_remapping = !is_remapping;
-            if(is_remapping) {
-                printf("start remapping\n");
-                c_im_kb.from = -1;
-                c_im_kb.to = -1;
-                im_index = -1;
-            } else {
-                printf("stopped remapping\n");
-                c_im_kb.from = -1;
-                c_im_kb.to = -1;
-                im_index = -1;
-            }
-        }
+        end_input_frame(&input);
+        do_input_remapping(&input);
 
-        if(is_remapping && !in_kb[SDL_SCANCODE_Q]) {
-            const char * scancode_name = NULL;
-            
-            if(im_index == -1) {
-                // await scancode to edit
-                
-                // find first key pressed this frame using scancode
-                for(int i = 0; i < SDL_NUM_SCANCODES; i++) {
-                    if(in_kb[i] && !in_kb_prev[i]) {
-                        
-                        scancode_name = SDL_GetScancodeName(i);
-                        printf("check scancode: %i, %s\n", i, scancode_name); 
-                        
-                        // find if scancode is actually used in current mapping
-                        for(int j = 0; j < 4; j++) {
-                            if(im_kb[j].from == i) {
-                                printf("found mapping at %i for given scancode %i, %s\n", j, i, scancode_name);
-                                im_index = j;
-                                break;
-                            } 
-                        }
-
-                        if(im_index == -1)
-                            printf("scancode %i, %s is not used in any mappings\n", i, scancode_name);
-        
-                    }               
-                }
-            } else {
-                // await scancode to swap to
-
-                // find first key pressed this frame using scancode
-                for(int i = 0; i < SDL_NUM_SCANCODES; i++) {
-                    if(in_kb[i] && !in_kb_prev[i]) {
-
-                        const char * prev_scancode_name = SDL_GetScancodeName(im_kb[im_index].from);
-                        scancode_name = SDL_GetScancodeName(i);
-
-                        printf("changed scancode %i, %s to %i, %s\n", 
-                                                im_kb[im_index].from, prev_scancode_name, 
-                                                i, scancode_name);
-                        
-                        im_kb[im_index].from = i;
-
-                        // TODO: handle multiple mappings using the same key -> removal
-                        for(int j = 0; j < 4; j++) {
-                            if(j != im_index) {
-                                if(im_kb[j].from == i) {
-                                    // mapping already existed. prioritise the new mapping and remove the previus one.
-                                    im_kb[j].from = -1;
-                                }
-                            }
-                        }
-
-                        im_index = -1;
-                        break;
-                    }
-                }
+        // without the queue actions are held for every tick this frame, nothing moves while remapping
+        if(!update.queue) {
+            for(int i = 0; i < SA_MAX; i++) {
+                sim_actions[i] = input.is_remapping ? 0 : action_down(&input, i);
             }
         }
-        else {
-            // use the mapping to read stuff 
-            struct index_map _im;
-            for(int i = 0; i < 4; i++) {
-                _im = im_kb[i];
-                if(_im.from > -1 && _im.to > -1) {
-                    iak[_im.to].value.i = in_kb[_im.from];
-                } else {
-                    // something is wrong with the mapping, clear to 0
-                    if(_im.to > -1) iak[_im.to].value.i = 0;
-                }
-            }
-
-            if(iak[0].value.i) { p_rot.z += 4.0f * frame_delta_time; }
-            if(iak[1].value.i) { p_rot.z -= 4.0f * frame_delta_time; }
-            if(iak[3].value.i) { 
-                // vel_y -= 1.0f; 
-
-                float rx = cos(p_rot.z);
-                float ry = sin(p_rot.z);
-
-                p_vel.x += rx * 4.0f * frame_delta_time;
-                p_vel.y += ry * 4.0f * frame_delta_time;
-
-                // p_x += rx * 4.0f * frame_delta_time;
-                // p_y += ry * 4.0f * frame_delta_time;
-            }
-            if(iak[3].value.i) {  }
+        if(input_log.mode == IL_RECORD) {
+            // the update is not running here, sim_curr.tick is the next tick, actions are logged per tick
+            for(int i = 0; i < input.num_events; i++) log_input_key(&input_log, sim_curr.tick, &input.events[i]);
         }
 
-        p_pos.x += p_vel.x * 4 * frame_delta_time;
-        p_pos.y += p_vel.y * 4 * frame_delta_time;
-        // damping
-        p_vel.x -= p_vel.x * 0.9 * frame_delta_time;
-        p_vel.y -= p_vel.y * 0.9 * frame_delta_time;
-
-        dx += vel_x * c_force_x * frame_delta_time;
-        dy += vel_y * c_force_y * frame_delta_time;
-
         end = get_time_us();
+        input_us = end;
+        key_us = input.num_events ? input_event_us(&input, input.events[0].timestamp) : 0;
         total_timing[TT_INPUT] += end - start;
+        fs->t[TT_INPUT] = end - start;
+        prof_end();
 
         start = end;
         // update:
-
-        float ft = frame_count * frame_delta_time;
-        // dx = 0.5 * cosf(ft);
-        // dy = 0.5 * sinf(ft);
+        prof_begin(time_tag_name[TT_COMPUTE]);
+
+        // fixed ticks from the measured frame time, then blend for rendering
+        // bench feeds exactly one tick per frame so every run does the same work
+        // a replay runs at replay_speed, 0 -> the catch-up cap every frame
+        if(bench_frames) {
+            update.frame_us = sim_clock.tick_us;
+        } else if(replaying) {
+            update.frame_us = replay_speed > 0.0f ? (unsigned long long int)((frame_start - prev_frame_start) * replay_speed)
+                                                  : sim_clock.tick_us * sim_clock.max_ticks;
+        } else {
+            update.frame_us = frame_start - prev_frame_start;
+        }
+        prev_frame_start = frame_start;
+        if(!update.queue) memcpy(update.actions, sim_actions, sizeof(sim_actions));
+        update.input_blocked = input.is_remapping;
+        update.input_until_us = input_us;
+        update.frame = frame_count;
+        update.input_us = input_us;
+        update.key_us = key_us;
+        if(pipelined) {
+            // runs on a worker while the previous snapshot is drawn below
+            update.out = &snapshots[frame_count & 1];
+            run_job(&jobs, update_frame_job, &update, 0, 1, &update_counter);
+        } else {
+            update_frame(&update);
+        }
 
         end = get_time_us();
-        total_timing[TT_COMPUTE] += end - start;
+        if(!pipelined) {
+            total_timing[TT_COMPUTE] += end - start;
+            fs->t[TT_COMPUTE] = end - start;
+        }
+        prof_end();
         
         start = end;
         // render:
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        prof_begin(time_tag_name[TT_RENDER]);
+        shown_input_us = 0;
+        shown_key_us = 0;
+        if(!headless) {
+            int win_w = res_w, win_h = res_h;
+            SDL_GL_GetDrawableSize(window, &win_w, &win_h);
+            resize_renderer(&renderer, win_w, win_h);
+
+            begin_gpu_frame(&renderer.gpu, frame_count);
+            if(pipelined) {
+                struct render_snapshot * snap = &snapshots[(frame_count + 1) & 1];
+                draw_scene(&renderer, &snap->sim, &snap->snakes, snap->alpha);
+                shown_input_us = snap->input_us;
+                shown_key_us = snap->key_us;
+            } else {
+                struct sim_state * shown = &sim_render;
+                struct sim_state latched;
+                if(late_input && !replaying && !input.is_remapping && peek_input_actions(&input, latch_actions)) {
+                    // keys that came in during the update turn the shown player, the sim reads them next frame
+                    latched = sim_render;
+                    latch_player(&latched.player, update.actions, latch_actions, (get_time_us() - input_us) / 1000000.0f);
+                    shown = &latched;
+                    latched_frames++;
+                }
+                draw_scene(&renderer, shown, &snakes, update.alpha);
+                shown_input_us = input_us;
+                shown_key_us = key_us;
+            }
 
-        float line_color[3] = { 1.0f, 1.0f, 1.0f };
+            // internal resolution -> letterboxed window
+            present_scene(&renderer);
+            end_gpu_frame(&renderer.gpu);
 
-        mat4 m_model, m_proj, m_view, m_vp, m_mvp;
+            prof_begin("swap");
+            glFlush();
+            SDL_GL_SwapWindow(window);
+            prof_end();
 
-        identity_mat4(&m_model);
-        identity_mat4(&m_proj);
-        identity_mat4(&m_view);
-        identity_mat4(&m_mvp);
-        identity_mat4(&m_vp);
-        
-        // translate + rotate model
-        // translate_mat4(dx, dy, 0, &m_model);
-
-        // perspective
-        float fov = 90.0f;
-        float aspect_ratio = 640.0f / 480.0f;
-        float z_near = 0.001f;
-        float z_far = 1000.0f;
-        perspective_mat4(fov * A2R, aspect_ratio, z_near, z_far, &m_proj);
-
-        // camera / lookat -> view
-        vec3 eye, dir, up;
-        // horrid
-        // set_vec3(dx, dy, 1, &eye);
-
-        // set_vec3(dx*2, dy*2, 1.0, &eye);
-        set_vec3(0.0, 0.0, 1.0, &eye);
-        set_vec3(0, 0, -1, &dir);
-        set_vec3(0, 1, 0, &up); 
-        lookat_mat4(eye, dir, up, &m_view);
-
-        // mul opengl 
-        mul_mat4(&m_proj, &m_view, &m_vp); // same view & proj for all models
-        mul_mat4(&m_vp, &m_model, &m_mvp); 
-
-        glBindVertexArray(line_vao);
-        glBindBuffer(GL_ARRAY_BUFFER, line_vbo);
-        glUseProgram(line_shader);
-
-        // test
-        // srand(frame_count);
-        float x, y, z;
-
-        // field
-        // field
-        x = y = 0.0f;
-        z = -5;
-        identity_mat4(&m_model);
-        scale_mat4(10, 10, 1, &m_model);
-        translate_mat4(x, y, z, &m_model);
-        mul_mat4(&m_vp, &m_model, &m_mvp); 
-        glUniform3fv(line_shader_color_loc, 1, (GLfloat*)&field_color);
-        glUniformMatrix4fv(line_shader_mvp_loc, 1, GL_FALSE, (GLfloat*)m_mvp.v);
-        glDrawArrays(GL_TRIANGLES, 3, 8); 
-
-        // snakes
-        for(int i = 0; i < 9; i++) {
-            x = -1.0f + cos(A2R*i * 45);
-            y = 1.0f + sin(A2R*i * 50);
-            z = -4;
-            identity_mat4(&m_model);
-
-            float dim = 1.0f - ((float)i / 9.0f);
-            scale_mat4(dim, dim, dim, &m_model);
-            translate_mat4(x, y, z, &m_model);
-            mul_mat4(&m_vp, &m_model, &m_mvp); 
-            glUniform3fv(line_shader_color_loc, 1, (GLfloat*)&snake_color);
-            glUniformMatrix4fv(line_shader_mvp_loc, 1, GL_FALSE, (GLfloat*)m_mvp.v);
-            glDrawArrays(GL_POLYGON, circle_first_index, circle_last_index); 
+            // earlier frames' gpu times, whatever is done by now
+            collect_gpu_timer(&renderer.gpu, &frame_timings);
         }
 
-        // eyes        
-        x = -1.0f + cos(A2R*0 * 45);
-        y = 1.0f + sin(A2R*0 * 50);
-        z = -3.9;
-        identity_mat4(&m_model);
-        scale_mat4(.5, .5, .5, &m_model);
-        translate_mat4(x, y, z, &m_model);
-        mul_mat4(&m_vp, &m_model, &m_mvp); 
-        glUniform3fv(line_shader_color_loc, 1, (GLfloat*)&snake_eye_color);
-        glUniformMatrix4fv(line_shader_mvp_loc, 1, GL_FALSE, (GLfloat*)m_mvp.v);
-        glDrawArrays(GL_POLYGON, circle_first_index, circle_last_index); 
-
-        // player
-        x = +2.0f;
-        y = -1.0f;
-        z = -4;
-        identity_mat4(&m_model);
-        scale_mat4(.5, .5, .5, &m_model);
-        rot_z_mat4(p_rot.z, &m_model); // self rot first
-        translate_mat4(p_pos.x, p_pos.y, p_pos.z, &m_model);
-        mul_mat4(&m_vp, &m_model, &m_mvp); 
-        glUniform3fv(line_shader_color_loc, 1, (GLfloat*)&player_color);
-        glUniformMatrix4fv(line_shader_mvp_loc, 1, GL_FALSE, (GLfloat*)m_mvp.v);
-        glDrawArrays(GL_TRIANGLES, 0, 3); 
-        
-        if(0)
-        for(int i = 0; i < 10; i++) {
-
-            line_color[0] = line_color[1] = line_color[2] = 1.0f / (i + 1);
-            glUniform3fv(line_shader_color_loc, 1, (GLfloat*)line_color);
-
-            // TRIANGLE
-            x = 0.0f;
-            y = 0.0f;
-            z = -2 + -((float)i * .25);
-
-            identity_mat4(&m_model);
-            translate_mat4(x, y, z, &m_model);
-            mul_mat4(&m_vp, &m_model, &m_mvp); 
-            glUniformMatrix4fv(line_shader_mvp_loc, 1, GL_FALSE, (GLfloat*)m_mvp.v);
-            glDrawArrays(GL_TRIANGLES, 0, 3); 
-
-            // SQUARE
-            x = y = 1.0f;
-            identity_mat4(&m_model);
-            translate_mat4(x, y, z, &m_model);
-            mul_mat4(&m_vp, &m_model, &m_mvp); 
-            glUniformMatrix4fv(line_shader_mvp_loc, 1, GL_FALSE, (GLfloat*)m_mvp.v);
-            glDrawArrays(GL_TRIANGLES, 3, 8); 
-
-            // CIRCLE
-            x = -2.0f;
-            y = 0.0f;
-            identity_mat4(&m_model);
-            translate_mat4(x, y, z, &m_model);
-            mul_mat4(&m_vp, &m_model, &m_mvp); 
-            glUniformMatrix4fv(line_shader_mvp_loc, 1, GL_FALSE, (GLfloat*)m_mvp.v);
-            glDrawArrays(GL_POLYGON, circle_first_index, circle_last_index); 
-        }
-
-        glUseProgram(0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);      
-
-        // TODO: render to lower resolution framebuffer and then render framebuffer to screen
-        // also keep aspect ratio
-        // and option for edge texture (not just black borders) 
-
-        glFlush();
-        SDL_GL_SwapWindow(window);
-
         end = get_time_us();
         total_timing[TT_RENDER] += end - start;
+        fs->t[TT_RENDER] = end - start;
+        if(shown_input_us) fs->latency = end - shown_input_us;
+        if(shown_key_us) {
+            if(end > shown_key_us) fs->key_latency = end - shown_key_us;
+            else key_after_swap++;
+        }
+        if(!headless) update_render_scale(&renderer, end - start);
+        prof_end();
+
+        if(pipelined) {
+            // the update usually finished during the render, if not this is the cost
+            prof_begin("wait update");
+            wait_job_counter(&jobs, &update_counter);
+            prof_end();
+            pipeline_wait_us += get_time_us() - end;
+
+            total_timing[TT_COMPUTE] += update.elapsed_us;
+            fs->t[TT_COMPUTE] = update.elapsed_us;
+        }
 
         frame_end = get_time_us();
-        frame_elapsed = frame_end - frame_start;
 
-        // sleep if there is time left!
-        sleep_time = 0;
-        if(frame_elapsed >= max_frame_time) {
+        // late input: the slot is where the next frame should be done, wake up its work earlier
+        if(late_input) feed_frame_pacer_work(&frame_pacer, (frame_end - frame_start) * 1000);
+
+        // sleep (+ spin) until the next slot on the frame grid
+        prof_begin(time_tag_name[TT_SLEEP]);
+        frame_late = (bench_frames || (replaying && replay_speed <= 0.0f)) ? 0 : wait_frame_pacer(&frame_pacer);
+        if(frame_late) {
             // bad frame - overflow!
-            printf("[frame %llu] no time to sleep - overflow by %llu us\n", frame_count, frame_elapsed - max_frame_time);
-        } else {
-            sleep_time = max_frame_time - frame_elapsed;
-            if(sleep_time < max_frame_time) {
-                sleep_us(sleep_time);
-            } else {
-                // no time left to sleep!
-                printf("[frame %llu] no time to sleep%llu us\n", frame_count);
-            }
-        } 
-        total_timing[TT_SLEEP] += sleep_time;
+            printf("[frame %llu] no time to sleep - overflow by %llu us\n", frame_count, frame_late / 1000);
+        }
+
+        end = get_time_us();
+        total_timing[TT_SLEEP] += end - frame_end;
+        fs->t[TT_SLEEP] = end - frame_end;
+        fs->total = end - frame_start;
+        prof_end();
 
         frame_count += 1;
+        if(bench_frames && frame_count >= bench_frames) quit = 1;
+        if(replaying && input_log.done) quit = 1;
     }
 
     start = get_time_us();
-    printf("Destroy GL context\n");
-    SDL_GL_DeleteContext(context);
+    prof_begin(time_tag_name[TT_DEINIT]);
+    sim_hash = hash_sim_state(&sim_curr, &snakes);
+    if(input_log.mode) close_input_log(&input_log, sim_curr.tick, sim_hash);
+    free_snakes(&snakes);
+    free_input(&input);
+    free_broadphase(&broadphase);
+    free_job_system(&jobs);
+    if(pipelined) {
+        free_render_snapshot(&snapshots[0]);
+        free_render_snapshot(&snapshots[1]);
+    }
 
-    printf("Destroy SDL windows\n");
-    SDL_DestroyWindow(window);
+    if(!headless) {
+        free_renderer(&renderer);
 
-    printf("Quit SDL\n");
-    SDL_Quit();    
+        if(update.queue) detach_input_queue(&input_queue);
+
+        printf("Destroy GL context\n");
+        SDL_GL_DeleteContext(context);
+
+        printf("Destroy SDL windows\n");
+        SDL_DestroyWindow(window);
+
+        printf("Quit SDL\n");
+        SDL_Quit();    
+    }
+    prof_end();
     end = get_time_us();
     total_timing[TT_DEINIT] = end - start;
     
+    // sim throughput, whole update stage (player + snakes) counts
+    double segments_per_ms = total_timing[TT_COMPUTE] ? 
+        (double)sim_clock.ticks * snake_count * snake_segments / (total_timing[TT_COMPUTE] / 1000.0) : 0.0;
+
     // runtime info:
     if(1) {
         printf("\n########################################\n");
@@ -959,18 +837,96 @@ int main(const int argc, const char ** argv) {
         printf("\n");
         printf("runtime info:\n");
         printf("num frames: %'9llu\n", frame_count);
+        printf("sim ticks:  %'9llu (%.0f Hz, %d frames hit the catch-up cap, %'llu ms dropped)\n", 
+                sim_clock.ticks, 1000000.0f / sim_clock.tick_us, 
+                sim_clock.capped_frames, sim_clock.dropped_us / 1000);
+        printf("snakes:     %'9d x %d segments, %d iterations, %'.0f segments / ms in update\n",
+                snake_count, snake_segments, snake_iterations, segments_per_ms);
+        if(collide_stats.ticks) {
+            printf("collision:  %'9llu items, %'llu candidate pairs, %'llu contacts per tick (avg), %'llu swept hits\n",
+                    collide_stats.items / collide_stats.ticks, collide_stats.pairs / collide_stats.ticks,
+                    collide_stats.contacts / collide_stats.ticks, collide_stats.swept_hits);
+        }
         
         printf("\nTimings:\n");
         for(i = 0; i < TT_MAX; i++) {
             printf("  %-9s %'9llu ms (%-5.2f %%)\n", time_tag_name[i], total_timing[i] / 1000, percent[i]);
+            if(i == TT_SLEEP) {
+                // how close frame starts landed to the grid
+                double n = frame_pacer.frames ? (double)frame_pacer.frames : 1.0;
+                double mean = frame_pacer.jitter_sum / n;
+                double var = frame_pacer.jitter_sq_sum / n - mean * mean;
+                printf("    pacing:  jitter mean %.1f us, sd %.1f us, max %.1f us, %llu missed deadlines\n",
+                        mean / 1000.0, sqrt(var > 0.0 ? var : 0.0) / 1000.0, 
+                        frame_pacer.jitter_max / 1000.0, frame_pacer.missed);
+                printf("    sleep:   oversleep avg %.1f us, max %.1f us, spin margin %llu us, %'llu ms spun\n",
+                        frame_pacer.oversleep_avg / 1000.0, frame_pacer.oversleep_max / 1000.0,
+                        frame_pacer_margin(&frame_pacer) / 1000, frame_pacer.spun_ns / 1000000);
+                if(late_input) {
+                    printf("    late:    input read %.1f us before the slot, %'llu frames re-latched the turn\n",
+                            frame_pacer.lead_ns / 1000.0, latched_frames);
+                }
+            }
         }
         
         printf("\n");
         // printf("frametime: %'9llu ms (%-5.2f %%)\n", active_frame_time / 1000, frame_percent_sum);
         printf("total runtime: %'9llu ms (%-5.2f %%)\n", runtime / 1000, percent_sum); 
+
+        print_job_system(&jobs);
+        print_input_log(&input_log, sim_hash);
+        if(key_after_swap) {
+            printf("key lat:    %'9llu frames had a key stamped after their swap (ms timestamps), not sampled\n", key_after_swap);
+        }
+        if(update.queue) print_input_queue(&input_queue);
+        if(!headless) print_render_stats(&renderer);
+        if(pipelined) {
+            printf("pipelined:  update overlapped render, %'llu ms waited on it (%.1f us / frame)\n",
+                    pipeline_wait_us / 1000, frame_count ? (double)pipeline_wait_us / frame_count : 0.0);
+        }
+
+        print_frame_timings(&frame_timings, max_frame_time);
         
         printf("\n########################################\n");
     }
 
+    if(bench_frames) {
+        // one json line, stderr because stdout goes to runtime.log when not on a tty
+        unsigned long long int bench_us = 0;
+        for(int i = TT_FRAME_FIRST; i <= TT_FRAME_LAST; i++) bench_us += total_timing[i];
+        double bench_s = (double)bench_us / 1000000.0;
+
+        FILE * bench_files[2] = { stderr, NULL };
+        if(bench_path != NULL) {
+            bench_files[1] = fopen(bench_path, "w");
+            if(bench_files[1] == NULL) printf("bench: could not open %s for writing\n", bench_path);
+        }
+
+        for(int i = 0; i < 2; i++) {
+            FILE * f = bench_files[i];
+            if(f == NULL) continue;
+            fprintf(f, "{\"frames\":%llu,\"seconds\":%.3f,\"fps\":%.1f,\"snakes\":%d,\"segments\":%d,"
+                       "\"iterations\":%d,\"threads\":%d,\"pipelined\":%d,\"headless\":%d,\"instanced\":%d,\"ticks\":%llu,\"segments_per_ms\":%.1f,"
+                       "\"pairs_per_tick\":%llu,\"stages_us\":",
+                    frame_count, bench_s, bench_s > 0.0 ? frame_count / bench_s : 0.0,
+                    snake_count, snake_segments, snake_iterations, jobs.num_threads, pipelined, headless, use_instancing, 
+                    sim_clock.ticks, segments_per_ms,
+                    collide_stats.ticks ? collide_stats.pairs / collide_stats.ticks : 0ull);
+            write_frame_timings_summary(f, &frame_timings);
+            fprintf(f, "}\n");
+        }
+        if(bench_files[1] != NULL) fclose(bench_files[1]);
+    }
+
+    if(timings_path != NULL) {
+        export_frame_timings(&frame_timings, timings_path);
+    }
+    free_frame_timings(&frame_timings);
+
+    if(trace_path != NULL) {
+        dump_profile(trace_path);
+    }
+    free_profile();
+
     return 0;
 }
@@ -3,6 +3,24 @@
 
 #include <math.h>
 
+/*
+    simd:
+        picked at compile time from the target flags (-msse / -mavx / -march=native)
+        define STG_MAT4_NO_SIMD to force the scalar code
+
+        SSE -> mul, transpose, lookat, rot_*, batch mul
+        AVX -> batch mul does two columns per op
+*/
+#if !defined(STG_MAT4_NO_SIMD) && defined(__SSE__)
+#define STG_MAT4_SSE
+#include <xmmintrin.h>
+#endif
+
+#if defined(STG_MAT4_SSE) && defined(__AVX__)
+#define STG_MAT4_AVX
+#include <immintrin.h>
+#endif
+
 struct vec4_s {
     union {
         float a[4];
@@ -89,26 +107,36 @@ struct mat4_s {
 
         float v[16];
         float m[4][4];
-        // __m128 r[4];
+#if defined(STG_MAT4_SSE)
+        __m128 r[4];
+#endif
 
         // named access into the rows
         struct {
             // ess. vec4            
-            struct {
-                // __m128 row0;
-                float m00, m01, m02, m03;
+            union {
+#if defined(STG_MAT4_SSE)
+                __m128 row0;
+#endif
+                struct { float m00, m01, m02, m03; };
             };
-            struct {
-                // __m128 row1;
-                float m10, m11, m12, m13;
+            union {
+#if defined(STG_MAT4_SSE)
+                __m128 row1;
+#endif
+                struct { float m10, m11, m12, m13; };
             };
-            struct {
-                // __m128 row2;
-                float m20, m21, m22, m23;
+            union {
+#if defined(STG_MAT4_SSE)
+                __m128 row2;
+#endif
+                struct { float m20, m21, m22, m23; };
             };
-            struct {
-                // __m128 row3;
-                float m30, m31, m32, m33;
+            union {
+#if defined(STG_MAT4_SSE)
+                __m128 row3;
+#endif
+                struct { float m30, m31, m32, m33; };
             };
         };
     };
@@ -142,7 +170,7 @@ void identity_mat4(mat4 * m) {
 }
 
 void copy_mat4(mat4 * target, mat4 * source) {
-    memcpy(source->v, target->v, sizeof(float) * 16);
+    memcpy(target->v, source->v, sizeof(float) * 16);
 }
 
 void translate_mat4(float x, float y, float z, mat4 * m) {
@@ -172,7 +200,51 @@ void perspective_mat4(float fov, float aspect_ratio, float z_near, float z_far,
     m->m[3][2] = 2.0f * (z_near * z_far * fn);
 }
 
+#if defined(STG_MAT4_SSE)
+static inline __m128 load_vec3_sse(vec3 * v) {
+    return _mm_set_ps(0.0f, v->z, v->y, v->x);
+}
+
+static inline __m128 cross_vec3_sse(__m128 a, __m128 b) {
+    __m128 a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 c = _mm_sub_ps(_mm_mul_ps(a, b_yzx), _mm_mul_ps(a_yzx, b));
+    return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+static inline __m128 norm_vec3_sse(__m128 a) {
+    __m128 d = _mm_mul_ps(a, a);
+    // horizontal add of xyz (w is 0)
+    d = _mm_add_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(2, 3, 0, 1)));
+    d = _mm_add_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(1, 0, 3, 2)));
+    if(_mm_cvtss_f32(d) == 0.0f) return _mm_setzero_ps();
+    return _mm_div_ps(a, _mm_sqrt_ps(d));
+}
+#endif
+
 void lookat_mat4(vec3 eye, vec3 dir, vec3 up, mat4 * m) {
+#if defined(STG_MAT4_SSE)
+    // f = norm(dir), same as norm((eye + dir) - eye) below
+    __m128 f = norm_vec3_sse(load_vec3_sse(&dir));
+    __m128 s = norm_vec3_sse(cross_vec3_sse(f, load_vec3_sse(&up)));
+    __m128 u = cross_vec3_sse(s, f);
+    __m128 nf = _mm_sub_ps(_mm_setzero_ps(), f);
+    __m128 w = _mm_setzero_ps();
+
+    // rows (s, u, -f, 0) -> columns
+    _MM_TRANSPOSE4_PS(s, u, nf, w);
+
+    // translation = -(R * eye)
+    __m128 t = _mm_mul_ps(s, _mm_set1_ps(eye.x));
+    t = _mm_add_ps(t, _mm_mul_ps(u, _mm_set1_ps(eye.y)));
+    t = _mm_add_ps(t, _mm_mul_ps(nf, _mm_set1_ps(eye.z)));
+    t = _mm_sub_ps(_mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f), t);
+
+    m->r[0] = s;
+    m->r[1] = u;
+    m->r[2] = nf;
+    m->r[3] = t;
+#else
     vec3 f, u, s, c;
 
     add_vec3(&eye, &dir, &c);
@@ -189,15 +261,39 @@ void lookat_mat4(vec3 eye, vec3 dir, vec3 up, mat4 * m) {
 	m->m[1][1] =  u.a[1];
 	m->m[1][2] = -f.a[1];
 	m->m[2][0] =  s.a[2];
+	m->m[2][1] =  u.a[2];
 	m->m[2][2] = -f.a[2];
 	m->m[3][0] = -dot_vec3(&s, &eye);
 	m->m[3][1] = -dot_vec3(&u, &eye);
 	m->m[3][2] =  dot_vec3(&f, &eye);
 	m->m[0][3] =  m->m[1][3] = m->m[2][3] = 0.0f;
 	m->m[3][3] =  1.0f;
+#endif
 }
 
+#if defined(STG_MAT4_SSE)
+// a * column, a given as its 4 columns
+static inline __m128 mul_col_mat4_sse(__m128 a0, __m128 a1, __m128 a2, __m128 a3, __m128 b) {
+    __m128 c;
+    c = _mm_mul_ps(a0, _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 0, 0, 0)));
+    c = _mm_add_ps(c, _mm_mul_ps(a1, _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 1, 1, 1))));
+    c = _mm_add_ps(c, _mm_mul_ps(a2, _mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 2, 2, 2))));
+    c = _mm_add_ps(c, _mm_mul_ps(a3, _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 3, 3, 3))));
+    return c;
+}
+#endif
+
 void mul_mat4(mat4 * a, mat4 * b, mat4 * c) {
+#if defined(STG_MAT4_SSE)
+    __m128 a0 = a->r[0], a1 = a->r[1], a2 = a->r[2], a3 = a->r[3];
+    __m128 b0 = b->r[0], b1 = b->r[1], b2 = b->r[2], b3 = b->r[3];
+
+    // c may alias a or b, so everything is loaded before the stores
+    c->r[0] = mul_col_mat4_sse(a0, a1, a2, a3, b0);
+    c->r[1] = mul_col_mat4_sse(a0, a1, a2, a3, b1);
+    c->r[2] = mul_col_mat4_sse(a0, a1, a2, a3, b2);
+    c->r[3] = mul_col_mat4_sse(a0, a1, a2, a3, b3);
+#else
     float 	
 		// load raw data
 		a00 = a->m[0][0], a01 = a->m[0][1], a02 = a->m[0][2], a03 = a->m[0][3],
@@ -227,9 +323,57 @@ void mul_mat4(mat4 * a, mat4 * b, mat4 * c) {
 	c->m[3][1] = (a01 * b30) + (a11 * b31) + (a21 * b32) + (a31 * b33);
 	c->m[3][2] = (a02 * b30) + (a12 * b31) + (a22 * b32) + (a32 * b33);
 	c->m[3][3] = (a03 * b30) + (a13 * b31) + (a23 * b32) + (a33 * b33);   
+#endif
+}
+
+// c[i] = a * b[i], for the shared view-projection * per-object model case
+void mul_mat4_batch(mat4 * a, mat4 * b, mat4 * c, int n) {
+#if defined(STG_MAT4_AVX)
+    // both 128 lanes hold the same column of a, each lane works on its own column of b
+    __m256 a0 = _mm256_broadcast_ps(&a->r[0]);
+    __m256 a1 = _mm256_broadcast_ps(&a->r[1]);
+    __m256 a2 = _mm256_broadcast_ps(&a->r[2]);
+    __m256 a3 = _mm256_broadcast_ps(&a->r[3]);
+
+    for(int i = 0; i < n; i++) {
+        float * src = b[i].v;
+        float * dst = c[i].v;
+        for(int j = 0; j < 16; j += 8) {
+            __m256 bb = _mm256_loadu_ps(src + j);
+            __m256 r;
+            r = _mm256_mul_ps(a0, _mm256_shuffle_ps(bb, bb, _MM_SHUFFLE(0, 0, 0, 0)));
+            r = _mm256_add_ps(r, _mm256_mul_ps(a1, _mm256_shuffle_ps(bb, bb, _MM_SHUFFLE(1, 1, 1, 1))));
+            r = _mm256_add_ps(r, _mm256_mul_ps(a2, _mm256_shuffle_ps(bb, bb, _MM_SHUFFLE(2, 2, 2, 2))));
+            r = _mm256_add_ps(r, _mm256_mul_ps(a3, _mm256_shuffle_ps(bb, bb, _MM_SHUFFLE(3, 3, 3, 3))));
+            _mm256_storeu_ps(dst + j, r);
+        }
+    }
+#elif defined(STG_MAT4_SSE)
+    __m128 a0 = a->r[0], a1 = a->r[1], a2 = a->r[2], a3 = a->r[3];
+
+    for(int i = 0; i < n; i++) {
+        __m128 b0 = b[i].r[0], b1 = b[i].r[1], b2 = b[i].r[2], b3 = b[i].r[3];
+        c[i].r[0] = mul_col_mat4_sse(a0, a1, a2, a3, b0);
+        c[i].r[1] = mul_col_mat4_sse(a0, a1, a2, a3, b1);
+        c[i].r[2] = mul_col_mat4_sse(a0, a1, a2, a3, b2);
+        c[i].r[3] = mul_col_mat4_sse(a0, a1, a2, a3, b3);
+    }
+#else
+    for(int i = 0; i < n; i++) {
+        mul_mat4(a, &b[i], &c[i]);
+    }
+#endif
 }
 
 void transpose_mat4(mat4 * m) {
+#if defined(STG_MAT4_SSE)
+    __m128 r0 = m->r[0], r1 = m->r[1], r2 = m->r[2], r3 = m->r[3];
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    m->r[0] = r0;
+    m->r[1] = r1;
+    m->r[2] = r2;
+    m->r[3] = r3;
+#else
     mat4 t;
     copy_mat4(&t, m);
 
@@ -249,88 +393,89 @@ void transpose_mat4(mat4 * m) {
 	m->m[3][2] = t.m[2][3];
 	m->m[2][3] = t.m[3][2];
     m->m[3][3] = t.m[3][3];    
+#endif
 }
 
-void rot_x_mat4(float x, mat4 * m) {
+/*
+    rotations are applied as m = R * m
+    R only touches two axes so each column of m gets a 2d rotation of those two
+    components instead of a full 4x4 mul
+*/
+#if defined(STG_MAT4_SSE)
+// col' = col * k1 + swizzle(col) * k2, swizzle swaps the two rotated components
+#define ROT_COLS_MAT4_SSE(m, k1, k2, swz) do {                                  \
+        for(int _i = 0; _i < 4; _i++) {                                         \
+            __m128 _c = (m)->r[_i];                                             \
+            (m)->r[_i] = _mm_add_ps(_mm_mul_ps(_c, (k1)),                       \
+                                    _mm_mul_ps(_mm_shuffle_ps(_c, _c, swz), (k2))); \
+        }                                                                       \
+    } while(0)
+#endif
+
+void rot_x_cs_mat4(float c, float s, mat4 * m) {
+#if defined(STG_MAT4_SSE)
+    // y' = c*y - s*z, z' = s*y + c*z
+    ROT_COLS_MAT4_SSE(m, _mm_set_ps(1.0f, c, c, 1.0f), _mm_set_ps(0.0f, s, -s, 0.0f),
+                        _MM_SHUFFLE(3, 1, 2, 0));
+#else
     mat4 v;
     identity_mat4(&v);
 
-    float c = cos(x);
-    float s = sin(x);
-
     v.m[1][1] = c;    
     v.m[1][2] = s;
     v.m[2][1] = -s;
     v.m[2][2] = c;
 
     mul_mat4(&v, m, m);
+#endif
 }
 
-void rot_y_mat4(float y, mat4 * m) {
+void rot_y_cs_mat4(float c, float s, mat4 * m) {
+#if defined(STG_MAT4_SSE)
+    // x' = c*x + s*z, z' = -s*x + c*z
+    ROT_COLS_MAT4_SSE(m, _mm_set_ps(1.0f, c, 1.0f, c), _mm_set_ps(0.0f, -s, 0.0f, s),
+                        _MM_SHUFFLE(3, 0, 1, 2));
+#else
     mat4 v;
     identity_mat4(&v);
 
-    float c = cos(y);
-    float s = sin(y);
-
     v.m[0][0] = c;    
     v.m[0][2] = -s;
     v.m[2][0] = s;
     v.m[2][2] = c;
 
     mul_mat4(&v, m, m);
+#endif
 }
 
-void rot_z_mat4(float z, mat4 * m) {
+void rot_z_cs_mat4(float c, float s, mat4 * m) {
+#if defined(STG_MAT4_SSE)
+    // x' = c*x - s*y, y' = s*x + c*y
+    ROT_COLS_MAT4_SSE(m, _mm_set_ps(1.0f, 1.0f, c, c), _mm_set_ps(0.0f, 0.0f, s, -s),
+                        _MM_SHUFFLE(3, 2, 0, 1));
+#else
     mat4 v;
     identity_mat4(&v);
 
-    float c = cos(z);
-    float s = sin(z);
-
     v.m[0][0] = c;    
     v.m[0][1] = s;
     v.m[1][0] = -s;
     v.m[1][1] = c;
 
     mul_mat4(&v, m, m);
+#endif
 }
 
-
-void rot_x_cs_mat4(float c, float s, mat4 * m) {
-    mat4 v;
-    identity_mat4(&v);
-
-    v.m[1][1] = c;    
-    v.m[1][2] = s;
-    v.m[2][1] = -s;
-    v.m[2][2] = c;
-
-    mul_mat4(&v, m, m);
+void rot_x_mat4(float x, mat4 * m) {
+    rot_x_cs_mat4(cos(x), sin(x), m);
 }
 
-void rot_y_cs_mat4(float c, float s, mat4 * m) {
-    mat4 v;
-    identity_mat4(&v);
-
-    v.m[0][0] = c;    
-    v.m[0][2] = -s;
-    v.m[2][0] = s;
-    v.m[2][2] = c;
-
-    mul_mat4(&v, m, m);
+void rot_y_mat4(float y, mat4 * m) {
+    rot_y_cs_mat4(cos(y), sin(y), m);
 }
 
-void rot_z_cs_mat4(float c, float s, mat4 * m) {
-    mat4 v;
-    identity_mat4(&v);
-
-    v.m[0][0] = c;    
-    v.m[0][1] = s;
-    v.m[1][0] = -s;
-    v.m[1][1] = c;
-
-    mul_mat4(&v, m, m);
+void rot_z_mat4(float z, mat4 * m) {
+    rot_z_cs_mat4(cos(z), sin(z), m);
 }
 
 void print_mat4(mat4 * m) {
@@ -0,0 +1,219 @@
+#ifndef STG_MESH_H
+#define STG_MESH_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <GL/glew.h>
+
+#include "glstate.h"
+
+/*
+    mesh library:
+        every shape lives in one vbo (positions) + one element buffer,
+        a mesh is an index range and the primitive it is drawn with
+            triangle    fan, 3 vertices
+            rect        strip, 4 vertices
+            line        lines, 2 vertices, unit length along x
+            circle      fan around the center, one mesh per lod
+        all of them are centered on 0 and fit into a 1 x 1 square,
+        indices are absolute (no base vertex needed) and 16 bit
+
+    element buffers are vao state, attach_mesh_library() is called with the
+    vao that will draw the meshes bound
+
+    circle lod:
+        picked per draw from the projected radius in pixels, the smallest
+        lod whose edge stays within MESH_CIRCLE_ERROR_PX of the true circle
+        sagitta of a segment = r * (1 - cos(pi / n)) -> n = pi / acos(1 - e / r)
+*/
+
+#define MESH_CIRCLE_LODS        8
+#define MESH_CIRCLE_ERROR_PX    0.5f
+#define MESH_PI                 3.14159265f
+
+enum mesh_id {
+    MESH_TRIANGLE = 0,
+    MESH_RECT,
+    MESH_LINE,
+    MESH_CIRCLE,    // most detailed lod, lod i is MESH_CIRCLE + i
+
+    MESH_MAX = MESH_CIRCLE + MESH_CIRCLE_LODS
+};
+
+// segments per circle lod, most detailed first
+static const int mesh_circle_segments[MESH_CIRCLE_LODS] = { 64, 48, 32, 24, 16, 12, 8, 6 };
+
+struct mesh {
+    GLenum mode;
+    int first;          // first index in the element buffer
+    int count;          // indices
+    int vertices;
+};
+
+struct mesh_library {
+    GLuint vbo, ibo;
+    struct mesh meshes[MESH_MAX];
+    int num_vertices, num_indices;
+
+    // stats, circle draws per lod
+    unsigned long long int lod_uses[MESH_CIRCLE_LODS];
+};
+
+// scratch while building, positions are xyz
+struct mesh_builder {
+    float * verts;
+    unsigned short * indices;
+    int num_vertices, num_indices;
+};
+
+static int add_mesh_vertex(struct mesh_builder * mb, float x, float y) {
+    float * v = mb->verts + 3 * mb->num_vertices;
+    v[0] = x;
+    v[1] = y;
+    v[2] = 0.0f;
+    return mb->num_vertices++;
+}
+
+static void begin_mesh(struct mesh_library * lib, struct mesh_builder * mb, int id, GLenum mode) {
+    lib->meshes[id].mode = mode;
+    lib->meshes[id].first = mb->num_indices;
+    lib->meshes[id].vertices = mb->num_vertices; // start, fixed up in end_mesh()
+}
+
+static void end_mesh(struct mesh_library * lib, struct mesh_builder * mb, int id) {
+    lib->meshes[id].count = mb->num_indices - lib->meshes[id].first;
+    lib->meshes[id].vertices = mb->num_vertices - lib->meshes[id].vertices;
+}
+
+static void build_meshes(struct mesh_library * lib, struct mesh_builder * mb) {
+    unsigned short * ix;
+
+    // points along +x (player heading), ccw
+    begin_mesh(lib, mb, MESH_TRIANGLE, GL_TRIANGLE_FAN);
+    ix = mb->indices + mb->num_indices;
+    ix[0] = add_mesh_vertex(mb, 0.5f, 0.0f);
+    ix[1] = add_mesh_vertex(mb, -0.5f, 0.5f);
+    ix[2] = add_mesh_vertex(mb, -0.5f, -0.5f);
+    mb->num_indices += 3;
+    end_mesh(lib, mb, MESH_TRIANGLE);
+
+    // both strip triangles ccw
+    begin_mesh(lib, mb, MESH_RECT, GL_TRIANGLE_STRIP);
+    ix = mb->indices + mb->num_indices;
+    ix[0] = add_mesh_vertex(mb, -0.5f, 0.5f);
+    ix[1] = add_mesh_vertex(mb, -0.5f, -0.5f);
+    ix[2] = add_mesh_vertex(mb, 0.5f, 0.5f);
+    ix[3] = add_mesh_vertex(mb, 0.5f, -0.5f);
+    mb->num_indices += 4;
+    end_mesh(lib, mb, MESH_RECT);
+
+    begin_mesh(lib, mb, MESH_LINE, GL_LINES);
+    ix = mb->indices + mb->num_indices;
+    ix[0] = add_mesh_vertex(mb, -0.5f, 0.0f);
+    ix[1] = add_mesh_vertex(mb, 0.5f, 0.0f);
+    mb->num_indices += 2;
+    end_mesh(lib, mb, MESH_LINE);
+
+    // center + rim, the rim is closed by repeating its first index
+    for(int lod = 0; lod < MESH_CIRCLE_LODS; lod++) {
+        int id = MESH_CIRCLE + lod;
+        int n = mesh_circle_segments[lod];
+
+        begin_mesh(lib, mb, id, GL_TRIANGLE_FAN);
+        ix = mb->indices + mb->num_indices;
+        *ix++ = add_mesh_vertex(mb, 0.0f, 0.0f);
+        int rim = mb->num_vertices;
+        for(int i = 0; i < n; i++) {
+            float a = 2.0f * MESH_PI * i / n;
+            *ix++ = add_mesh_vertex(mb, cosf(a) * 0.5f, sinf(a) * 0.5f);
+        }
+        *ix++ = rim;
+        mb->num_indices += n + 2;
+        end_mesh(lib, mb, id);
+    }
+}
+
+void init_mesh_library(struct mesh_library * lib) {
+    struct mesh_builder mb;
+    int max_vertices = 3 + 4 + 2, max_indices = 3 + 4 + 2;
+
+    memset(lib, 0, sizeof(struct mesh_library));
+    for(int lod = 0; lod < MESH_CIRCLE_LODS; lod++) {
+        max_vertices += mesh_circle_segments[lod] + 1;
+        max_indices += mesh_circle_segments[lod] + 2;
+    }
+
+    mb.verts = malloc(sizeof(float) * 3 * max_vertices);
+    mb.indices = malloc(sizeof(unsigned short) * max_indices);
+    mb.num_vertices = mb.num_indices = 0;
+    build_meshes(lib, &mb);
+
+    lib->num_vertices = mb.num_vertices;
+    lib->num_indices = mb.num_indices;
+
+    glGenBuffers(1, &lib->vbo);
+    glGenBuffers(1, &lib->ibo);
+
+    gls_bind_buffer(GL_ARRAY_BUFFER, lib->vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 3 * mb.num_vertices, mb.verts, GL_STATIC_DRAW);
+
+    // no vao may be bound here, it would keep the element buffer
+    gls_bind_vertex_array(0);
+    gls_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, lib->ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned short) * mb.num_indices, mb.indices, GL_STATIC_DRAW);
+    gls_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    free(mb.verts);
+    free(mb.indices);
+}
+
+void free_mesh_library(struct mesh_library * lib) {
+    glDeleteBuffers(1, &lib->vbo);
+    glDeleteBuffers(1, &lib->ibo);
+    lib->vbo = lib->ibo = 0;
+}
+
+// with the vao bound: positions -> pos_loc, the element buffer becomes part of the vao
+void attach_mesh_library(struct mesh_library * lib, GLint pos_loc) {
+    gls_bind_buffer(GL_ARRAY_BUFFER, lib->vbo);
+    glVertexAttribPointer(pos_loc, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(pos_loc);
+    gls_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, lib->ibo);
+}
+
+// mesh id of the cheapest circle that looks round at radius_px pixels
+int circle_lod(struct mesh_library * lib, float radius_px) {
+    int lod = 0;
+    if(radius_px > MESH_CIRCLE_ERROR_PX) {
+        float need = MESH_PI / acosf(1.0f - MESH_CIRCLE_ERROR_PX / radius_px);
+        // from the cheap end, first lod with enough segments
+        for(lod = MESH_CIRCLE_LODS - 1; lod > 0; lod--) {
+            if(mesh_circle_segments[lod] >= need) break;
+        }
+    } else {
+        lod = MESH_CIRCLE_LODS - 1;
+    }
+    lib->lod_uses[lod]++;
+    return MESH_CIRCLE + lod;
+}
+
+// the vao that was attached to lib must be bound
+void draw_mesh(struct mesh_library * lib, int id) {
+    struct mesh * m = &lib->meshes[id];
+    gls_draw_elements(m->mode, m->count, GL_UNSIGNED_SHORT, sizeof(unsigned short) * m->first);
+}
+
+void print_mesh_library(struct mesh_library * lib, unsigned long long int frames) {
+    unsigned long long int n = frames ? frames : 1;
+    printf("meshes:     %9d meshes, %d vertices, %d indices, circles per frame by segments:",
+            MESH_MAX, lib->num_vertices, lib->num_indices);
+    for(int lod = 0; lod < MESH_CIRCLE_LODS; lod++) {
+        printf(" %d:%llu", mesh_circle_segments[lod], lib->lod_uses[lod] / n);
+    }
+    printf("\n");
+}
+
+#endif /* STG_MESH_H */
@@ -0,0 +1,153 @@
+#ifndef STG_PIPELINE_H
+#define STG_PIPELINE_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+#include "snakes.h"
+#include "broadphase.h"
+#include "collision.h"
+#include "jobs.h"
+#include "profile.h"
+#include "inputlog.h"
+#include "inputqueue.h"
+
+/*
+    frame update + render snapshots:
+        update_frame() runs the fixed ticks for one frame and blends the
+        render state, everything it touches lives in struct update_s so it
+        can run on any thread
+
+    pipelined mode:
+        the update writes an immutable render snapshot (interpolated sim state
+        + snake positions) instead of the renderer reading the live state
+        frame N: update N runs as a job while the main thread (owns GL) draws
+        the snapshot of frame N - 1, then waits for the job
+            -> frame time ~ max(update, render) instead of update + render
+            -> one frame more latency, input_us / key_us in the snapshot are carried to
+               the swap so the cost shows up in the report
+        two snapshots are enough: N is written while N - 1 is read
+
+    input per tick:
+        replay log, else the input queue drained at the tick boundary, else
+        the actions the frame filled in are held for all of its ticks
+*/
+
+struct render_snapshot {
+    unsigned long long int frame;
+    unsigned long long int input_us;    // when the input this state saw was read
+    unsigned long long int key_us;      // first key event in that input, 0 -> none
+    float alpha;
+
+    struct sim_state sim;               // already interpolated
+    struct snakes snakes;               // x, y, px, py only
+};
+
+struct update_s {
+    // owned by whoever runs update_frame()
+    struct sim_clock * clock;
+    struct sim_state * prev, * curr, * render;
+    struct snakes * snakes;
+    struct broadphase * bp;
+    struct collide_stats * stats;
+    struct job_system * js;
+
+    // per frame, filled in before the update starts
+    int actions[SA_MAX];
+    struct input_log * replay;          // NULL -> actions are held for every tick, else set per tick from the log
+    struct input_queue * queue;         // NULL -> same, else drained per tick (replay wins)
+    struct input * input;               // bindings for the queue
+    int input_blocked;                  // remapping, the queue is drained but nothing is held
+    unsigned long long int input_until_us;  // queue records up to here belong to this frame's last tick
+    struct input_log * record;          // NULL -> not recording, else the actions of every tick are logged
+    unsigned long long int frame_us;    // time fed to the sim clock
+    unsigned long long int frame;
+    unsigned long long int input_us;
+    unsigned long long int key_us;
+    struct render_snapshot * out;       // NULL -> no snapshot, render reads the live state
+
+    // out
+    float alpha;
+    unsigned long long int elapsed_us;
+};
+
+void init_render_snapshot(struct render_snapshot * snap, struct snakes * s) {
+    size_t n = (size_t)s->stride * s->segments;
+
+    memset(snap, 0, sizeof(struct render_snapshot));
+    snap->snakes = *s;
+    snap->snakes.x = aligned_alloc(32, sizeof(float) * n);
+    snap->snakes.y = aligned_alloc(32, sizeof(float) * n);
+    snap->snakes.px = aligned_alloc(32, sizeof(float) * n);
+    snap->snakes.py = aligned_alloc(32, sizeof(float) * n);
+    snap->snakes.heading = NULL;
+    snap->snakes.phase = NULL;
+}
+
+void free_render_snapshot(struct render_snapshot * snap) {
+    free_snakes(&snap->snakes);
+}
+
+void fill_render_snapshot(struct render_snapshot * snap, struct sim_state * render, struct snakes * s,
+                            float alpha, unsigned long long int frame, unsigned long long int input_us,
+                            unsigned long long int key_us) {
+    size_t bytes = sizeof(float) * s->stride * s->segments;
+
+    snap->frame = frame;
+    snap->input_us = input_us;
+    snap->key_us = key_us;
+    snap->alpha = alpha;
+    snap->sim = *render;
+
+    memcpy(snap->snakes.x, s->x, bytes);
+    memcpy(snap->snakes.y, s->y, bytes);
+    memcpy(snap->snakes.px, s->px, bytes);
+    memcpy(snap->snakes.py, s->py, bytes);
+}
+
+void update_frame(struct update_s * u) {
+    unsigned long long int start = get_time_us();
+    PROF_SCOPE("update frame");
+
+    int ticks = advance_sim_clock(u->clock, u->frame_us);
+    for(int i = 0; i < ticks; i++) {
+        // the log decides the actions, and when the run is over
+        if(u->replay) {
+            if(!replay_input_actions(u->replay, u->curr->tick, u->actions)) {
+                u->clock->ticks -= ticks - i;   // not run
+                break;
+            }
+        } else if(u->queue) {
+            // the ticks of a frame are one tick_us apart, the last one sees everything read this frame
+            // (ms timestamps can map a bit past input_until_us)
+            unsigned long long int until = i == ticks - 1 ? ~0ull : u->input_until_us - (ticks - 1 - i) * u->clock->tick_us;
+            drain_input_queue(u->queue, until, u->input, u->actions);
+            if(u->input_blocked) memset(u->actions, 0, sizeof(u->actions));
+        }
+        if(u->record) log_input_actions(u->record, u->curr->tick, u->actions);
+        *u->prev = *u->curr;
+        tick_sim(u->curr, u->actions, u->clock->dt);
+        tick_snakes_parallel(u->snakes, u->clock->dt, u->js);
+        collide_scene(u->bp, u->snakes, u->curr, &u->prev->player.pos, u->stats);
+        step_spears(u->bp, u->snakes, u->curr, u->clock->dt, u->stats);
+    }
+
+    u->alpha = sim_clock_alpha(u->clock);
+    lerp_sim_state(u->prev, u->curr, u->alpha, u->render);
+
+    if(u->out) {
+        PROF_SCOPE("snapshot");
+        fill_render_snapshot(u->out, u->render, u->snakes, u->alpha, u->frame, u->input_us, u->key_us);
+    }
+
+    u->elapsed_us = get_time_us() - start;
+}
+
+static void update_frame_job(void * data, int begin, int end) {
+    (void)begin;
+    (void)end;
+    update_frame(data);
+}
+
+#endif /* STG_PIPELINE_H */
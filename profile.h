@@ -0,0 +1,238 @@
+#ifndef STG_PROFILE_H
+#define STG_PROFILE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <time.h>
+
+/*
+    profiling zones:
+        prof_begin(name) / prof_end() pairs, or PROF_SCOPE(name) for the rest of a block
+        zones nest, the viewer rebuilds the tree from the begin / end order
+        names must be string literals (or live until the dump)
+
+        every thread records into its own buffer, allocated on its first zone
+        only the owning thread writes to it -> no locks or atomics per zone
+        registering a new thread is the only atomic op
+
+        dump_profile(path) writes chrome://tracing / perfetto json,
+        call it after all other threads are done recording
+
+    timestamps:
+        CLOCK_MONOTONIC_RAW by default
+        STG_PROFILE_RDTSC -> rdtsc, calibrated against CLOCK_MONOTONIC_RAW at init and dump
+
+    STG_NO_PROFILE compiles all of it out
+*/
+
+#if !defined(STG_NO_PROFILE)
+
+#if defined(STG_PROFILE_RDTSC)
+#include <x86intrin.h>
+#endif
+
+#define PROF_MAX_THREADS        64
+#define PROF_EVENTS_PER_THREAD  (1 << 18)
+
+struct prof_event {
+    unsigned long long int ts;  // raw ticks
+    const char * name;
+    char type;                  // 'B' / 'E'
+};
+
+struct prof_thread {
+    int tid;
+    const char * name;
+
+    int count;
+    int depth;          // recorded zones still open
+    int skip_depth;     // zones dropped because the buffer was full
+    int dropped;
+    struct prof_event * events;
+};
+
+int prof_enabled = 0;
+unsigned long long int prof_t0_ticks, prof_t0_ns;
+
+struct prof_thread * prof_threads[PROF_MAX_THREADS];
+atomic_int prof_thread_count = 0;
+
+static _Thread_local struct prof_thread * prof_tls = NULL;
+static _Thread_local int prof_no_slot = 0;  // registering failed, do not retry
+
+static inline unsigned long long int prof_raw_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (unsigned long long int)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static inline unsigned long long int prof_ticks(void) {
+#if defined(STG_PROFILE_RDTSC)
+    return __rdtsc();
+#else
+    return prof_raw_ns();
+#endif
+}
+
+void prof_init(int enabled) {
+    prof_enabled = enabled;
+    prof_t0_ns = prof_raw_ns();
+    prof_t0_ticks = prof_ticks();
+}
+
+static struct prof_thread * prof_register_thread(void) {
+    if(prof_no_slot) return NULL;
+
+    int tid = atomic_fetch_add(&prof_thread_count, 1);
+    if(tid >= PROF_MAX_THREADS) {
+        // out of slots, only this thread is not recorded
+        prof_no_slot = 1;
+        return NULL;
+    }
+
+    struct prof_thread * t = calloc(1, sizeof(struct prof_thread));
+    t->tid = tid;
+    t->name = tid == 0 ? "main" : "worker";
+    t->events = malloc(sizeof(struct prof_event) * PROF_EVENTS_PER_THREAD);
+
+    prof_threads[tid] = t;
+    prof_tls = t;
+    return t;
+}
+
+void prof_thread_name(const char * name) {
+    if(!prof_enabled) return;
+    struct prof_thread * t = prof_tls ? prof_tls : prof_register_thread();
+    if(t) t->name = name;
+}
+
+static inline void prof_begin(const char * name) {
+    if(!prof_enabled) return;
+    struct prof_thread * t = prof_tls ? prof_tls : prof_register_thread();
+    if(t == NULL) return;
+
+    // keep room for the end events of every open zone
+    if(t->skip_depth || t->count + t->depth + 1 >= PROF_EVENTS_PER_THREAD) {
+        t->skip_depth++;
+        t->dropped++;
+        return;
+    }
+
+    struct prof_event * e = &t->events[t->count++];
+    e->name = name;
+    e->type = 'B';
+    e->ts = prof_ticks();
+    t->depth++;
+}
+
+static inline void prof_end(void) {
+    if(!prof_enabled) return;
+    struct prof_thread * t = prof_tls;
+    if(t == NULL) return;
+
+    if(t->skip_depth) {
+        t->skip_depth--;
+        return;
+    }
+    if(t->depth == 0) return; // unmatched end
+
+    struct prof_event * e = &t->events[t->count++];
+    e->ts = prof_ticks();
+    e->name = NULL;
+    e->type = 'E';
+    t->depth--;
+}
+
+static inline void prof_scope_end(int * unused) {
+    (void)unused;
+    prof_end();
+}
+
+#define PROF_CONCAT_(a, b)  a##b
+#define PROF_CONCAT(a, b)   PROF_CONCAT_(a, b)
+#define PROF_SCOPE(name) \
+    int PROF_CONCAT(prof_scope_, __LINE__) __attribute__((cleanup(prof_scope_end))) = (prof_begin(name), 0)
+
+int dump_profile(const char * path) {
+    FILE * f = fopen(path, "w");
+    if(f == NULL) {
+        printf("profile: could not open %s for writing\n", path);
+        return -1;
+    }
+
+    // ticks -> us since prof_init
+    double us_per_tick = 0.001;
+#if defined(STG_PROFILE_RDTSC)
+    {
+        unsigned long long int ns = prof_raw_ns() - prof_t0_ns;
+        unsigned long long int ticks = prof_ticks() - prof_t0_ticks;
+        us_per_tick = ticks ? (double)ns / (double)ticks * 0.001 : 0.0;
+    }
+#endif
+
+    int threads = atomic_load(&prof_thread_count);
+    if(threads > PROF_MAX_THREADS) threads = PROF_MAX_THREADS;
+
+    int first = 1;
+    int events = 0;
+    int dropped = 0;
+
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for(int i = 0; i < threads; i++) {
+        struct prof_thread * t = prof_threads[i];
+        if(t == NULL) continue;
+
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", t->tid, t->name);
+        first = 0;
+
+        for(int j = 0; j < t->count; j++) {
+            struct prof_event * e = &t->events[j];
+            double ts = (double)(e->ts - prof_t0_ticks) * us_per_tick;
+            if(e->type == 'B') {
+                fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"stg\",\"ph\":\"B\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}",
+                        e->name, t->tid, ts);
+            } else {
+                fprintf(f, ",\n{\"ph\":\"E\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}", t->tid, ts);
+            }
+        }
+
+        events += t->count;
+        dropped += t->dropped;
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+
+    printf("profile: wrote %d events from %d threads to %s", events, threads, path);
+    if(dropped) printf(" (%d zones dropped, buffer full)", dropped);
+    printf("\n");
+    return 0;
+}
+
+void free_profile(void) {
+    int threads = atomic_load(&prof_thread_count);
+    if(threads > PROF_MAX_THREADS) threads = PROF_MAX_THREADS;
+    for(int i = 0; i < threads; i++) {
+        if(prof_threads[i] == NULL) continue;
+        free(prof_threads[i]->events);
+        free(prof_threads[i]);
+        prof_threads[i] = NULL;
+    }
+    prof_tls = NULL;
+    prof_enabled = 0;
+}
+
+#else
+
+#define prof_init(enabled)      ((void)0)
+#define prof_thread_name(name)  ((void)0)
+#define prof_begin(name)        ((void)0)
+#define prof_end()              ((void)0)
+#define PROF_SCOPE(name)        ((void)0)
+#define dump_profile(path)      (printf("profile: compiled out (STG_NO_PROFILE)\n"), -1)
+#define free_profile()          ((void)0)
+
+#endif /* STG_NO_PROFILE */
+
+#endif /* STG_PROFILE_H */
@@ -0,0 +1,652 @@
+#ifndef STG_RENDER_H
+#define STG_RENDER_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <GL/glew.h>
+
+#include "mat4.h"
+#include "profile.h"
+#include "shader.h"
+#include "stream.h"
+#include "instance.h"
+#include "sim.h"
+#include "snakes.h"
+#include "rendercmd.h"
+#include "target.h"
+#include "camera.h"
+#include "glstate.h"
+#include "mesh.h"
+#include "sdf.h"
+#include "gputimer.h"
+
+/*
+    renderer:
+        owns every gl object used to draw the scene
+        init_renderer() needs a current gl context with glew loaded
+        draw_scene() clears and draws one frame into the render target,
+        present_scene() puts it on the window, the caller swaps
+
+    the scene is not drawn inline, every object becomes a render command
+    (rendercmd.h), the queue is sorted and executed with state only changing
+    where the key does, in the batched paths a run of commands with the same
+    pass / shader / vao / mesh is one instanced draw
+
+    draw paths, best available first:
+        instancing  per instance attribs (divisor), gl 3.3
+        objects     per instance data in a ubo read by gl_InstanceID, gl 3.1
+        per object  one draw + model uniform each, anything else
+    the shaders do vp * model, vp comes from the camera ubo (camera.h) or,
+    without ubos, one uniform per program and frame
+
+    circles are either circle meshes at a lod picked from their size on
+    screen or, with sdf on, quads shaded by sdf.h in the RP_BLEND pass
+*/
+
+enum render_shader {
+    RS_LINE = 0,
+    RS_INSTANCE,        // instancing or objects, whichever the batches use
+    RS_SDF,             // sdf circles, per object or batched like the rest
+
+    RS_MAX
+};
+
+// ids of the mesh library, a circle is drawn with RM_CIRCLE + lod
+enum render_mesh {
+    RM_TRIANGLE = MESH_TRIANGLE,
+    RM_RECT = MESH_RECT,
+    RM_LINE = MESH_LINE,
+    RM_CIRCLE = MESH_CIRCLE,
+
+    RM_MAX = MESH_MAX
+};
+
+enum render_vao {
+    RV_LINE = 0,
+    RV_SDF,             // sdf batch
+    RV_INST,            // + mesh, one per instance batch
+
+    RV_MAX = RV_INST + RM_MAX
+};
+
+enum render_material {
+    RMAT_FIELD = 0,
+    RMAT_SNAKE,
+    RMAT_SNAKE_EYE,
+    RMAT_PLAYER,
+    RMAT_SPEAR,
+
+    RMAT_MAX
+};
+
+// key ids -> gl names, what a render_key refers to
+struct render_data_s {
+    int vbo_count, vao_count;
+    GLuint vbos[1], vaos[RV_MAX];
+
+    int shader_count;
+    GLuint shaders[RS_MAX];
+};
+
+// uniforms the executor sets, -1 -> not in the program
+struct render_locs {
+    GLint vp, model, color, outline;
+};
+
+struct render_stats {
+    unsigned long long int frames;
+    unsigned long long int cmds;
+    // draws, binds and uniform calls are counted by the gl state tracker
+};
+
+// ring for per frame uploads, grows if a frame does not fit
+#define RENDER_STREAM_SIZE  (1 << 20)
+
+// render keys store the distance from the camera (at z = 1) for front to back order
+#define RENDER_CAMERA_Z     1.0f
+#define RENDER_FAR          1000.0f
+
+struct renderer {
+    int use_instancing;
+    int use_ubo;
+    int batched;        // commands are drawn through the instance batches
+    int use_sdf;        // circles as sdf quads
+    float sdf_outline;  // quad units, 0 -> none
+
+    vec4 background_color;
+    vec4 materials[RMAT_MAX];
+
+    struct render_data_s data;
+    struct mesh_library meshes;
+
+    // every program, uniform locations come from its map
+    struct shader_registry shaders;
+
+    GLuint line_vao, line_shader;
+    struct render_locs locs[RS_MAX];
+
+    // batched paths, one batch per mesh
+    GLuint inst_shader;
+    struct instance_batch batches[RM_MAX];
+
+    GLuint sdf_shader;
+    struct instance_batch sdf_batch;
+
+    struct camera camera;
+
+    // per frame geometry, instance data goes here
+    struct stream_buffer stream;
+
+    // internal resolution, independent of the window
+    struct render_target target;
+    struct dynres dynres;
+
+    // gpu time per pass, the caller begins / ends the frame around draw + present
+    struct gpu_timer gpu;
+
+    // draw_scene() builds this, sorts and executes it
+    struct render_queue queue;
+    struct render_stats stats;
+};
+
+struct render_options {
+    int instancing;
+    int ubo;
+    int w, h;                   // internal resolution
+    const char * shader_cache;  // dir for program binaries, NULL -> always compile
+    int sdf;                    // circles as sdf quads
+    int sdf_outline;            // outline width in % of the radius
+    int gpu_timer;              // timestamp queries per pass
+};
+
+static void get_render_locs(struct shader * sh, struct render_locs * locs) {
+    locs->vp = shader_loc(sh, "vp");
+    locs->model = shader_loc(sh, "model");
+    locs->color = shader_loc(sh, "color");
+    locs->outline = shader_loc(sh, "outline");
+}
+
+void init_renderer(struct renderer * ren, struct render_options * opt) {
+    int w = opt->w, h = opt->h;
+    struct shader * sh;
+
+    ren->use_instancing = opt->instancing;
+    ren->use_ubo = opt->ubo;
+    ren->use_sdf = opt->sdf;
+    ren->sdf_outline = opt->sdf_outline * 0.01f * 0.5f;
+    ren->sdf_shader = 0;
+    for(int i = 0; i < RS_MAX; i++) ren->locs[i].vp = ren->locs[i].model = ren->locs[i].color = ren->locs[i].outline = -1;
+    init_render_queue(&ren->queue);
+    memset(&ren->stats, 0, sizeof(struct render_stats));
+
+    // everything below goes through the tracker, starts from nothing known
+    gls_reset();
+
+	gls_set_cap(GL_DEPTH_TEST, 1);
+    gls_depth_func(GL_LESS);
+    gls_depth_mask(1);
+
+    // actually situationally dependant (diff between see-through models)
+    glFrontFace(GL_CCW);
+    gls_set_cap(GL_CULL_FACE, 1);
+    gls_cull_face(GL_BACK);
+
+	glEnable(GL_TEXTURE_2D);
+
+	gls_set_cap(GL_BLEND, 1);
+	gls_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // glViewport(0, 0, 640, 480);
+
+    set_rgb_vec4(173, 216, 230, &ren->background_color); // light sky blue
+    set_rgb_vec4(58, 191, 91, &ren->materials[RMAT_FIELD]); // dark field green
+    set_rgb_vec4(41, 41, 41, &ren->materials[RMAT_SNAKE]); // blue dark snake
+    set_rgb_vec4(255, 35, 22, &ren->materials[RMAT_SNAKE_EYE]); // vivid red
+    set_rgb_vec4(250, 253, 248, &ren->materials[RMAT_PLAYER]); // light bone
+    set_rgb_vec4(139, 90, 43, &ren->materials[RMAT_SPEAR]); // wood brown
+
+    // red backgroud
+    glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
+    {
+        float r, g, b;
+        
+        // light sky blue
+        r = 173.0f / 255.0f;
+        g = 216.0f / 255.0f;
+        b = 230.0f / 255.0f;
+
+        // light field green
+        r = 114.0f / 255.0f;
+        g = 212.0f / 255.0f;
+        b = 138.0f / 255.0f;
+
+        // dark field green
+        r = 58.0f / 255.0f;
+        g = 191.0f / 255.0f;
+        b = 91.0f / 255.0f;
+
+        // dark snake
+        r = 4.0f / 255.0f;
+        g = 14.0f / 255.0f;
+        b = 7.0f / 255.0f;
+
+        // blue dark snake
+        r = 17.0f / 255.0f;
+        g = 25.0f / 255.0f;
+        b = 27.0f / 255.0f;
+
+        // vivid red
+        r = 255.0f / 255.0f;
+        g = 35.0f / 255.0f;
+        b = 22.0f / 255.0f;
+
+        // vivid yellow
+        r = 255.0f / 255.0f;
+        g = 210.0f / 255.0f;
+        b = 22.0f / 255.0f;
+
+        glClearColor(r, g, b, 1.0f);
+    }
+
+    glClearColor(ren->background_color.x, ren->background_color.y, ren->background_color.z, ren->background_color.w);
+
+    init_shader_registry(&ren->shaders, opt->shader_cache);
+
+    // pick the draw path first, shaders depend on it
+    if(ren->use_ubo && !has_uniform_buffers()) {
+        printf("* uniform buffers not supported, camera goes through uniforms\n");
+        ren->use_ubo = 0;
+    }
+    if(ren->use_instancing && !has_instancing()) {
+        printf("* instancing not supported, using %s\n", ren->use_ubo ? "object ubos" : "per-object draws");
+        ren->use_instancing = 0;
+    }
+    ren->batched = ren->use_instancing || ren->use_ubo;
+
+
+    prof_begin("line shader + geometry");
+    
+    {
+        // does not work on my pc -> needs newer opengl version
+        #if 0
+        const char * line_vertex_shader_src = 
+            "#version 330 core\n"
+            "layout (location = 0) in vec3 pos;\n"
+            "uniform mat4 proj;\n"
+            "uniform mat4 view;\n"            
+            "void main() { \n"
+            "\tmat4 mvp = view * proj;\n"
+            "\tgl_Position = mvp * vec4(pos, 1.0f);\n"
+            "}\0";
+            // "uniform mat4 mvp;\n"
+
+        const char * line_fragment_shader_src = 
+            "#version 330 core\n"
+            "out vec4 fragcolor;\n"
+            "uniform vec3 color;\n"
+            "void main() { \n"
+            "\tfragcolor = vec4(color, 1.0f);\n"
+            "}\0";
+        #else
+
+        const char * line_vertex_shader_src = 
+            "#version 130\n"
+            "uniform mat4 vp;\n"
+            "uniform mat4 model;\n"
+            "in vec3 pos;\n"
+            "out vec2 v_local;\n"
+            "void main() {\n"
+            "\tv_local = pos.xy;\n"
+            "\tgl_Position = vp * model * vec4(pos, 1.0f);\n"
+            "}\0";
+
+        const char * line_fragment_shader_src = 
+            "#version 130\n"
+            "uniform vec3 color;\n"
+            "out vec4 fragcolor;\n"
+            "void main() {\n"
+            "\tfragcolor = vec4(color, 1.0f);\n"
+            "}\0";
+        #endif
+    
+        sh = get_shader(&ren->shaders, "line", line_vertex_shader_src, line_fragment_shader_src);
+        ren->line_shader = sh->program;
+        gls_use_program(ren->line_shader);
+
+        // every shape, indexed
+        init_mesh_library(&ren->meshes);
+
+        glGenVertexArrays(1, &ren->line_vao);
+        gls_bind_vertex_array(ren->line_vao);
+        attach_mesh_library(&ren->meshes, 0);
+
+        get_render_locs(sh, &ren->locs[RS_LINE]);
+
+        if(ren->use_sdf && !ren->batched) {
+            sh = get_shader(&ren->shaders, "sdf", line_vertex_shader_src, sdf_fragment_shader_src);
+            ren->sdf_shader = sh->program;
+            get_render_locs(sh, &ren->locs[RS_SDF]);
+        }
+
+        // unbind 
+        gls_bind_vertex_array(0);
+        gls_use_program(0);
+
+        printf("shader comp complete\n");
+    }
+    prof_end();
+
+    init_stream_buffer(&ren->stream, GL_ARRAY_BUFFER, RENDER_STREAM_SIZE);
+
+    init_camera(&ren->camera, 90.0f * A2R, (float)w / h, 0.001f, RENDER_FAR, ren->use_ubo);
+
+    // batched paths: one batch per mesh, geometry shared with the line vao
+    ren->inst_shader = 0;
+
+    if(ren->batched) {
+        PROF_SCOPE("instance shader + batches");
+        const char * vs = instance_vertex_shader_src;
+        if(!ren->use_instancing) vs = object_vertex_shader_src;
+        else if(ren->use_ubo) vs = instance_ubo_vertex_shader_src;
+
+        sh = get_shader(&ren->shaders, ren->use_instancing ? "instance" : "object", vs, instance_fragment_shader_src);
+        ren->inst_shader = sh->program;
+        if(ren->use_ubo) bind_uniform_blocks(ren->inst_shader);
+        get_render_locs(sh, &ren->locs[RS_INSTANCE]);
+
+        for(int i = 0; i < RM_MAX; i++) {
+            init_instance_batch(&ren->batches[i], ren->inst_shader, &ren->meshes, i);
+        }
+
+        if(ren->use_sdf) {
+            sh = get_shader(&ren->shaders, ren->use_instancing ? "instance sdf" : "object sdf",
+                            vs, instance_sdf_fragment_shader_src);
+            ren->sdf_shader = sh->program;
+            if(ren->use_ubo) bind_uniform_blocks(ren->sdf_shader);
+            get_render_locs(sh, &ren->locs[RS_SDF]);
+            init_instance_batch(&ren->sdf_batch, ren->sdf_shader, &ren->meshes, RM_RECT);
+        }
+    }
+
+    // key ids -> gl names
+    memset(&ren->data, 0, sizeof(struct render_data_s));
+    ren->data.vbo_count = 1;
+    ren->data.vbos[0] = ren->meshes.vbo;
+    ren->data.vao_count = RV_MAX;
+    ren->data.vaos[RV_LINE] = ren->line_vao;
+    ren->data.shader_count = RS_MAX;
+    ren->data.shaders[RS_LINE] = ren->line_shader;
+    ren->data.shaders[RS_SDF] = ren->sdf_shader;
+    if(ren->batched) {
+        ren->data.shaders[RS_INSTANCE] = ren->inst_shader;
+        for(int i = 0; i < RM_MAX; i++) {
+            ren->data.vaos[RV_INST + i] = ren->batches[i].vao;
+        }
+        if(ren->use_sdf) ren->data.vaos[RV_SDF] = ren->sdf_batch.vao;
+    }
+
+    init_render_target(&ren->target, w, h);
+    init_dynres(&ren->dynres, 0, 0);
+    init_gpu_timer(&ren->gpu, opt->gpu_timer);
+}
+
+void free_renderer(struct renderer * ren) {
+    if(ren->batched) {
+        for(int i = 0; i < RM_MAX; i++) {
+            free_instance_batch(&ren->batches[i]);
+        }
+        if(ren->use_sdf) free_instance_batch(&ren->sdf_batch);
+    }
+    free_camera(&ren->camera);
+    free_render_target(&ren->target);
+    free_gpu_timer(&ren->gpu);
+    free_stream_buffer(&ren->stream);
+    glDeleteVertexArrays(1, &ren->line_vao);
+    free_mesh_library(&ren->meshes);
+    free_shader_registry(&ren->shaders);
+
+    free_render_queue(&ren->queue);
+}
+
+// fill in item->model after
+static struct render_item * push_render_cmd(struct renderer * ren, int mesh, int material, float z) {
+    int shader = ren->batched ? RS_INSTANCE : RS_LINE;
+    int vao = ren->batched ? RV_INST + mesh : RV_LINE;
+
+    struct render_item * item = push_render_queue(&ren->queue, 
+            make_render_key(RP_WORLD, shader, vao, mesh, material, RENDER_CAMERA_Z - z, RENDER_FAR));
+    item->mesh = mesh;
+    item->material = material;
+    return item;
+}
+
+// rect model for a spear, tip at the spear position, pointing along its velocity
+static void spear_model(struct spear_s * sp, mat4 * m) {
+    float a = atan2f(sp->vel.y, sp->vel.x);
+    identity_mat4(m);
+    scale_mat4(SPEAR_LENGTH, SPEAR_RADIUS * 2.0f, 1, m);
+    rot_z_mat4(a, m);
+    translate_mat4(sp->pos.x - cosf(a) * SPEAR_LENGTH * 0.5f, 
+                    sp->pos.y - sinf(a) * SPEAR_LENGTH * 0.5f, sp->pos.z, m);
+}
+
+// pixels per world unit at distance 1 from the camera, for circle_lod()
+static float render_pixel_scale(struct renderer * ren) {
+    int view_h = ren->target.fbo ? ren->target.view_h : ren->target.dst_h;
+    return view_h * 0.5f / tanf(ren->camera.fov * 0.5f);
+}
+
+// circle of world radius r at depth z, fill in item->model after (unit mesh, radius .5)
+static struct render_item * push_circle_cmd(struct renderer * ren, float pixel_scale, float r,
+                                            int material, float z) {
+    float dist = RENDER_CAMERA_Z - z;
+
+    if(ren->use_sdf) {
+        // blended edge -> back to front after the opaque world
+        int vao = ren->batched ? RV_SDF : RV_LINE;
+        struct render_item * item = push_render_queue(&ren->queue,
+                make_render_key(RP_BLEND, RS_SDF, vao, RM_RECT, material, RENDER_FAR - dist, RENDER_FAR));
+        item->mesh = RM_RECT;
+        item->material = material;
+        return item;
+    }
+
+    float px = dist > 0.0f ? r * pixel_scale / dist : 0.0f;
+    return push_render_cmd(ren, circle_lod(&ren->meshes, px), material, z);
+}
+
+// one command per object, no gl calls
+static void build_scene_cmds(struct renderer * ren, struct sim_state * sim, struct snakes * snakes, float alpha) {
+    struct render_item * item;
+    float x, y, z;
+    float pixel_scale = render_pixel_scale(ren);
+
+    clear_render_queue(&ren->queue);
+
+    // field
+    z = -5;
+    item = push_render_cmd(ren, RM_RECT, RMAT_FIELD, z);
+    identity_mat4(&item->model);
+    scale_mat4(10, 10, 1, &item->model);
+    translate_mat4(0.0f, 0.0f, z, &item->model);
+
+    // snakes
+    z = -4;
+    for(int i = 0; i < snakes->count; i++) {
+        for(int j = 0; j < snakes->segments; j++) {
+            float dim = snake_segment_scale(snakes, j);
+            get_snake_segment(snakes, i, j, alpha, &x, &y);
+
+            // unit circle mesh has radius .5
+            item = push_circle_cmd(ren, pixel_scale, dim * 0.5f, RMAT_SNAKE, z);
+            identity_mat4(&item->model);
+            scale_mat4(dim, dim, dim, &item->model);
+            translate_mat4(x, y, z, &item->model);
+        }
+    }
+
+    // eyes
+    z = -3.9;
+    for(int i = 0; i < snakes->count; i++) {
+        get_snake_segment(snakes, i, 0, alpha, &x, &y);
+        item = push_circle_cmd(ren, pixel_scale, 0.25f, RMAT_SNAKE_EYE, z);
+        identity_mat4(&item->model);
+        scale_mat4(.5, .5, .5, &item->model);
+        translate_mat4(x, y, z, &item->model);
+    }
+
+    // player
+    item = push_render_cmd(ren, RM_TRIANGLE, RMAT_PLAYER, sim->player.pos.z);
+    identity_mat4(&item->model);
+    scale_mat4(.5, .5, .5, &item->model);
+    rot_z_mat4(sim->player.rot.z, &item->model); // self rot first
+    translate_mat4(sim->player.pos.x, sim->player.pos.y, sim->player.pos.z, &item->model);
+
+    // spears
+    for(int i = 0; i < MAX_SPEARS; i++) {
+        if(sim->spears[i].life <= 0.0f) continue;
+        item = push_render_cmd(ren, RM_RECT, RMAT_SPEAR, sim->spears[i].pos.z);
+        spear_model(&sim->spears[i], &item->model);
+    }
+}
+
+/*
+    sorted queue -> gl, a change of the state bits of the key is where a
+    program / vao may change, the calls go to the state tracker which drops
+    the ones that match what is bound, same for vp and the material color
+    RP_BLEND is depth tested but does not write depth (the blended sdf rims
+    would hide the next segment at the same z), writes are back on after
+*/
+static void execute_render_queue(struct renderer * ren) {
+    struct render_queue * q = &ren->queue;
+    mat4 * vp = &ren->camera.m.vp;
+    render_key state = ~0ull;
+    struct render_locs * locs = &ren->locs[RS_LINE];
+
+    ren->stats.frames++;
+    ren->stats.cmds += q->num;
+
+    if(ren->batched) {
+        // a run of the same state is one batch, material is per instance
+        struct instance_batch * b = NULL;
+
+        for(int c = 0; c < q->num; c++) {
+            render_key key = q->cmds[c].key;
+            struct render_item * item = &q->items[q->cmds[c].item];
+
+            if((key & RK_STATE_MASK) != state) {
+                if(b) draw_instance_batch(b, &ren->stream);
+                state = key & RK_STATE_MASK;
+                gls_depth_mask(render_key_field(key, RK_PASS_SHIFT, 0xf) != RP_BLEND);
+
+                int s = render_key_field(key, RK_SHADER_SHIFT, 0xf);
+                int v = render_key_field(key, RK_VAO_SHIFT, 0xff);
+                gls_use_program(ren->data.shaders[s]);
+                if(ren->locs[s].vp >= 0) gls_uniform_mat4(ren->locs[s].vp, (GLfloat*)vp->v);
+                if(ren->locs[s].outline >= 0) gls_uniform_1f(ren->locs[s].outline, ren->sdf_outline);
+
+                // the batch binds its own vao
+                b = v == RV_SDF ? &ren->sdf_batch : &ren->batches[item->mesh];
+                clear_instance_batch(b);
+            }
+
+            instance * inst = push_instance_batch(b);
+            inst->model = item->model;
+            inst->color = ren->materials[item->material];
+        }
+        if(b) draw_instance_batch(b, &ren->stream);
+    } else {
+        for(int c = 0; c < q->num; c++) {
+            render_key key = q->cmds[c].key;
+            struct render_item * item = &q->items[q->cmds[c].item];
+
+            if((key & RK_STATE_MASK) != state) {
+                state = key & RK_STATE_MASK;
+                gls_depth_mask(render_key_field(key, RK_PASS_SHIFT, 0xf) != RP_BLEND);
+
+                int s = render_key_field(key, RK_SHADER_SHIFT, 0xf);
+                int v = render_key_field(key, RK_VAO_SHIFT, 0xff);
+                locs = &ren->locs[s];
+                gls_use_program(ren->data.shaders[s]);
+                gls_uniform_mat4(locs->vp, (GLfloat*)vp->v);
+                if(locs->outline >= 0) gls_uniform_1f(locs->outline, ren->sdf_outline);
+                gls_bind_vertex_array(ren->data.vaos[v]);
+            }
+            gls_uniform_vec3(locs->color, (GLfloat*)&ren->materials[item->material]);
+
+            // vp * model in the shader
+            gls_uniform_mat4(locs->model, (GLfloat*)item->model.v);
+            draw_mesh(&ren->meshes, item->mesh);
+        }
+    }
+    gls_depth_mask(1);
+}
+
+// player comes from the interpolated sim state, snakes are blended by alpha
+void draw_scene(struct renderer * ren, struct sim_state * sim, struct snakes * snakes, float alpha) {
+    mark_gpu_pass(&ren->gpu, GT_SCENE);
+    begin_render_target(&ren->target, &ren->background_color);
+
+    // camera / lookat -> view, only rebuilt + uploaded when it moved
+    vec3 eye, dir, up;
+    // horrid
+    // set_vec3(dx, dy, 1, &eye);
+
+    // set_vec3(dx*2, dy*2, 1.0, &eye);
+    set_vec3(0.0, 0.0, RENDER_CAMERA_Z, &eye);
+    set_vec3(0, 0, -1, &dir);
+    set_vec3(0, 1, 0, &up); 
+    set_camera_lookat(&ren->camera, eye, dir, up);
+    set_camera_aspect(&ren->camera, (float)ren->target.w / ren->target.h);
+    update_camera(&ren->camera);
+
+    prof_begin("build commands");
+    build_scene_cmds(ren, sim, snakes, alpha);
+    sort_render_queue(&ren->queue);
+    prof_end();
+
+    prof_begin("execute commands");
+    begin_stream_frame(&ren->stream);
+    execute_render_queue(ren);
+    end_stream_frame(&ren->stream);
+    prof_end();
+}
+
+// window drawable size, before draw_scene()
+void resize_renderer(struct renderer * ren, int win_w, int win_h) {
+    if(win_w != ren->target.win_w || win_h != ren->target.win_h) {
+        resize_render_target(&ren->target, win_w, win_h);
+    }
+}
+
+// after draw_scene(), before the swap
+void present_scene(struct renderer * ren) {
+    mark_gpu_pass(&ren->gpu, GT_BLIT);
+    present_render_target(&ren->target);
+}
+
+// measured render time of the frame (TT_RENDER), picks the next frame's resolution
+void update_render_scale(struct renderer * ren, unsigned long long int render_us) {
+    if(update_dynres(&ren->dynres, render_us)) {
+        set_render_target_scale(&ren->target, ren->dynres.scale);
+    }
+}
+
+void print_render_stats(struct renderer * ren) {
+    unsigned long long int n = ren->stats.frames ? ren->stats.frames : 1;
+    printf("render:     %'9llu commands per frame (avg), circles as %s\n", ren->stats.cmds / n,
+            ren->use_sdf ? "sdf quads" : "mesh lods");
+    print_gl_state(ren->stats.frames);
+    printf("camera:     %'9llu rebuilds, %s\n", ren->camera.rebuilds,
+            ren->use_ubo ? "camera ubo" : "vp uniform per program");
+    print_mesh_library(&ren->meshes, ren->stats.frames);
+    print_stream_buffer(&ren->stream);
+    print_shader_registry(&ren->shaders);
+    print_dynres(&ren->dynres, &ren->target);
+    print_gpu_timer(&ren->gpu);
+}
+
+#endif /* STG_RENDER_H */
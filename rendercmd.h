@@ -0,0 +1,149 @@
+#ifndef STG_RENDERCMD_H
+#define STG_RENDERCMD_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mat4.h"
+
+/*
+    render commands:
+        gameplay code pushes one command per object: a 64 bit sort key plus
+        what to draw (model, mesh, material)
+        the queue is radix sorted on the key once per frame and executed in
+        order, so state only changes where the key changes and runs with the
+        same state can be drawn as one instanced batch
+
+    key, high -> low bits:
+        63..60  pass        (RP_*)
+        59..56  shader      (index into render_data_s.shaders)
+        55..48  vao         (index into render_data_s.vaos)
+        47..40  mesh        (RM_*)
+        39..32  material    (RMAT_*)
+        31..8   depth       (24 bit, front to back, RP_BLEND back to front)
+         7..0   unused
+*/
+
+#define RK_PASS_SHIFT       60
+#define RK_SHADER_SHIFT     56
+#define RK_VAO_SHIFT        48
+#define RK_MESH_SHIFT       40
+#define RK_MATERIAL_SHIFT   32
+#define RK_DEPTH_SHIFT      8
+
+#define RK_DEPTH_MAX        ((1u << 24) - 1)
+
+// everything that picks gl state (pass .. mesh), what is left only changes uniforms
+#define RK_STATE_MASK       (~0ull << RK_MESH_SHIFT)
+
+enum render_pass {
+    RP_WORLD = 0,
+    RP_BLEND,       // after the opaque world, depth is stored back to front
+    RP_OVERLAY,
+
+    RP_MAX
+};
+
+typedef unsigned long long int render_key;
+
+struct render_cmd {
+    render_key key;
+    int item;       // -> render_queue.items
+};
+
+struct render_item {
+    mat4 model;
+    int mesh;
+    int material;
+};
+
+struct render_queue {
+    int num, cap;
+    struct render_cmd * cmds;
+    struct render_cmd * tmp;    // radix sort scratch
+    struct render_item * items;
+};
+
+// depth = distance from the camera, 0 .. far -> 0 .. RK_DEPTH_MAX
+static inline render_key make_render_key(int pass, int shader, int vao, int mesh, int material,
+                                            float depth, float far) {
+    float d = depth / far;
+    if(d < 0.0f) d = 0.0f;
+    if(d > 1.0f) d = 1.0f;
+
+    return ((render_key)pass << RK_PASS_SHIFT) |
+           ((render_key)(shader & 0xf) << RK_SHADER_SHIFT) |
+           ((render_key)(vao & 0xff) << RK_VAO_SHIFT) |
+           ((render_key)(mesh & 0xff) << RK_MESH_SHIFT) |
+           ((render_key)(material & 0xff) << RK_MATERIAL_SHIFT) |
+           ((render_key)(d * RK_DEPTH_MAX) << RK_DEPTH_SHIFT);
+}
+
+#define render_key_field(key, shift, mask)  ((int)(((key) >> (shift)) & (mask)))
+
+void init_render_queue(struct render_queue * q) {
+    memset(q, 0, sizeof(struct render_queue));
+}
+
+void free_render_queue(struct render_queue * q) {
+    free(q->cmds);
+    free(q->tmp);
+    free(q->items);
+    memset(q, 0, sizeof(struct render_queue));
+}
+
+void clear_render_queue(struct render_queue * q) {
+    q->num = 0;
+}
+
+// returns the item to fill, valid until the next push
+struct render_item * push_render_queue(struct render_queue * q, render_key key) {
+    if(q->num == q->cap) {
+        q->cap = q->cap ? q->cap * 2 : 256;
+        q->cmds = realloc(q->cmds, sizeof(struct render_cmd) * q->cap);
+        q->tmp = realloc(q->tmp, sizeof(struct render_cmd) * q->cap);
+        q->items = realloc(q->items, sizeof(struct render_item) * q->cap);
+    }
+    q->cmds[q->num].key = key;
+    q->cmds[q->num].item = q->num;
+    return &q->items[q->num++];
+}
+
+/*
+    lsd radix sort, 8 bits per pass, stable
+    a byte that is the same in every key (unused bits, one pass only ..) is skipped
+*/
+void sort_render_queue(struct render_queue * q) {
+    int n = q->num;
+    int count[256];
+    struct render_cmd * src = q->cmds;
+    struct render_cmd * dst = q->tmp;
+
+    for(int shift = 0; shift < 64; shift += 8) {
+        memset(count, 0, sizeof(count));
+        for(int i = 0; i < n; i++) {
+            count[(src[i].key >> shift) & 0xff]++;
+        }
+        if(n == 0 || count[(src[0].key >> shift) & 0xff] == n) continue;
+
+        int sum = 0;
+        for(int b = 0; b < 256; b++) {
+            int c = count[b];
+            count[b] = sum;
+            sum += c;
+        }
+        for(int i = 0; i < n; i++) {
+            dst[count[(src[i].key >> shift) & 0xff]++] = src[i];
+        }
+
+        struct render_cmd * t = src;
+        src = dst;
+        dst = t;
+    }
+
+    // odd number of passes leaves the result in the scratch buffer
+    q->cmds = src;
+    q->tmp = dst;
+}
+
+#endif /* STG_RENDERCMD_H */
@@ -0,0 +1,57 @@
+#ifndef STG_SDF_H
+#define STG_SDF_H
+
+/*
+    sdf circles:
+        a circle is the unit rect (4 vertices) with the same model matrix as
+        the circle mesh, the vertex shader passes the quad position (v_local,
+        -0.5 .. 0.5) and the fragment shader turns the distance to the rim
+        into coverage, fwidth() makes the edge one pixel wide at any size
+        -> round at every scale, anti-aliased, no lods needed
+
+        outline > 0 darkens a ring of that width (quad units, radius is 0.5)
+        inside the rim to half the fill color
+
+        fragments outside the circle are discarded, the edge is blended ->
+        sdf circles go into the RP_BLEND pass, drawn after the opaque world
+        and back to front, depth tested without depth writes so a partly
+        covered rim never hides the overlapping next segment at the same z
+*/
+
+#define SDF_CIRCLE_FUNC_SRC \
+    "uniform float outline;\n" \
+    "vec4 sdf_circle(vec2 p, vec3 color) {\n" \
+    "\tfloat d = length(p) - 0.5;\n" \
+    "\tfloat w = max(fwidth(d), 0.00001);\n" \
+    "\tfloat a = clamp(0.5 - d / w, 0.0, 1.0);\n" \
+    "\tif(outline > 0.0) color *= mix(0.5, 1.0, clamp(0.5 - (d + outline) / w, 0.0, 1.0));\n" \
+    "\treturn vec4(color, a);\n" \
+    "}\n"
+
+// per object, color uniform like the line shader
+const char * sdf_fragment_shader_src =
+    "#version 130\n"
+    SDF_CIRCLE_FUNC_SRC
+    "uniform vec3 color;\n"
+    "in vec2 v_local;\n"
+    "out vec4 fragcolor;\n"
+    "void main() {\n"
+    "\tvec4 c = sdf_circle(v_local, color);\n"
+    "\tif(c.a <= 0.0) discard;\n"
+    "\tfragcolor = c;\n"
+    "}\0";
+
+// batched, color per instance
+const char * instance_sdf_fragment_shader_src =
+    "#version 130\n"
+    SDF_CIRCLE_FUNC_SRC
+    "in vec4 v_color;\n"
+    "in vec2 v_local;\n"
+    "out vec4 fragcolor;\n"
+    "void main() {\n"
+    "\tvec4 c = sdf_circle(v_local, v_color.rgb);\n"
+    "\tif(c.a <= 0.0) discard;\n"
+    "\tfragcolor = vec4(c.rgb, c.a * v_color.a);\n"
+    "}\0";
+
+#endif /* STG_SDF_H */
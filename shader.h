@@ -0,0 +1,302 @@
+#ifndef STG_SHADER_H
+#define STG_SHADER_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>   // mkdir()
+
+#include <GL/glew.h>
+
+/*
+    shader registry:
+        every program is built through get_shader() with a tag + sources
+        at link time all active uniforms are looked up once and kept as a
+        hashed name -> location map, shader_loc() reads from that map and
+        never asks the driver
+
+    binary cache:
+        linked programs are saved with glGetProgramBinary to
+        <cache_dir>/<hash>.bin, hash = sources + vendor / renderer / version
+        string, so a driver update or a source edit is a miss
+        a warm start loads the binary and skips compile + link, a binary the
+        driver refuses (GL_LINK_STATUS false) is rebuilt from source
+        needs gl 4.1 or ARB_get_program_binary, else everything compiles
+
+    build_shader_program() compiles both stages and links before asking for
+    any status, so the driver can work on them in the background, logs are
+    only read when linking failed
+*/
+
+#define SHADER_MAX          16
+#define SHADER_LOC_MAX      32
+#define SHADER_CACHE_MAGIC  0x31475453u // "STG1"
+
+struct shader {
+    int id;             // registry index
+    char * tag;
+    GLuint program;
+    unsigned long long int hash;
+    int from_cache;
+
+    // map: hashed uniform name -> location
+    int loc_count;
+    unsigned int loc_tags[SHADER_LOC_MAX];  // key
+    GLint locs[SHADER_LOC_MAX];             // value
+};
+
+struct shader_registry {
+    int count;
+    struct shader shaders[SHADER_MAX];
+
+    const char * cache_dir;     // NULL -> no binary cache
+    int binary;                 // driver can save / load programs
+    unsigned long long int driver_hash;
+
+    // stats
+    int compiled, loaded, saved;
+    unsigned long long int build_us;    // compile + link + save, or load
+};
+
+static inline unsigned long long int hash_shader_str(unsigned long long int h, const char * s) {
+    // fnv-1a 64
+    while(*s) {
+        h ^= (unsigned char)*s++;
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+static inline unsigned int hash_uniform_name(const char * s) {
+    // fnv-1a 32, "name[0]" of an array is stored as "name"
+    unsigned int h = 0x811c9dc5u;
+    while(*s && *s != '[') {
+        h ^= (unsigned char)*s++;
+        h *= 0x01000193u;
+    }
+    return h;
+}
+
+static void print_shader_log(GLuint shader, const char * what) {
+    char buf[1024];
+    GLsizei written = 0;
+    glGetShaderInfoLog(shader, sizeof(buf), &written, buf);
+    printf("%s: comp err: %s\n", what, buf);
+}
+
+// compile + link a vertex / fragment pair, errors are printed but not fatal
+GLuint build_shader_program_ex(const char * vertex_shader_src, const char * fragment_shader_src, int retrievable) {
+    GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertex_shader, 1, &vertex_shader_src, NULL);
+    glCompileShader(vertex_shader);
+
+    GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragment_shader, 1, &fragment_shader_src, NULL);
+    glCompileShader(fragment_shader);
+
+    // link to shader program
+    GLuint shader_program = glCreateProgram();
+    // glBindAttribLocation(shader_program, 0, "pos");
+
+    glAttachShader(shader_program, vertex_shader);
+    glAttachShader(shader_program, fragment_shader);
+    if(retrievable) glProgramParameteri(shader_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(shader_program);
+
+    // first status query, everything above could run in parallel
+    GLint status;
+    glGetProgramiv(shader_program, GL_LINK_STATUS, &status);
+    if(status == GL_FALSE) {
+        GLint ok;
+        glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &ok);
+        if(ok == GL_FALSE) print_shader_log(vertex_shader, "vs");
+        glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &ok);
+        if(ok == GL_FALSE) print_shader_log(fragment_shader, "fs");
+
+        char buf[1024];
+        GLsizei written = 0;
+        glGetProgramInfoLog(shader_program, sizeof(buf), &written, buf);
+        printf("link err: %s\n", buf);
+    }
+
+    glDetachShader(shader_program, vertex_shader);
+    glDetachShader(shader_program, fragment_shader);
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+
+    return shader_program;
+}
+
+GLuint build_shader_program(const char * vertex_shader_src, const char * fragment_shader_src) {
+    return build_shader_program_ex(vertex_shader_src, fragment_shader_src, 0);
+}
+
+// cache_dir NULL or "" -> always compile
+void init_shader_registry(struct shader_registry * reg, const char * cache_dir) {
+    memset(reg, 0, sizeof(struct shader_registry));
+
+    GLint formats = 0;
+    if(GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary) {
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    }
+    reg->binary = formats > 0;
+    reg->cache_dir = (cache_dir && *cache_dir && reg->binary) ? cache_dir : NULL;
+
+    // a different driver can not load our binaries
+    unsigned long long int h = 0xcbf29ce484222325ull;
+    const char * s;
+    if((s = (const char *)glGetString(GL_VENDOR))) h = hash_shader_str(h, s);
+    if((s = (const char *)glGetString(GL_RENDERER))) h = hash_shader_str(h, s);
+    if((s = (const char *)glGetString(GL_VERSION))) h = hash_shader_str(h, s);
+    reg->driver_hash = h;
+
+    if(reg->cache_dir) {
+        mkdir(reg->cache_dir, 0755); // fine if it exists
+        printf("* shader cache: %s\n", reg->cache_dir);
+    } else {
+        printf("* shader cache: off (%s)\n", reg->binary ? "disabled" : "no program binaries");
+    }
+}
+
+static void shader_cache_path(struct shader_registry * reg, struct shader * sh, char * path, size_t size) {
+    snprintf(path, size, "%s/%016llx.bin", reg->cache_dir, sh->hash);
+}
+
+// 1 -> sh->program is linked from the cache
+static int load_shader_binary(struct shader_registry * reg, struct shader * sh) {
+    char path[512];
+    unsigned int header[3]; // magic, format, length
+    shader_cache_path(reg, sh, path, sizeof(path));
+
+    FILE * f = fopen(path, "rb");
+    if(f == NULL) return 0;
+
+    int ok = 0;
+    if(fread(header, sizeof(header), 1, f) == 1 && header[0] == SHADER_CACHE_MAGIC && header[2] > 0) {
+        void * data = malloc(header[2]);
+        if(fread(data, header[2], 1, f) == 1) {
+            GLint status = GL_FALSE;
+            sh->program = glCreateProgram();
+            glProgramBinary(sh->program, header[1], data, header[2]);
+            glGetProgramiv(sh->program, GL_LINK_STATUS, &status);
+            if(status == GL_TRUE) {
+                ok = 1;
+            } else {
+                printf("shader cache: %s refused by the driver, rebuilding\n", path);
+                glDeleteProgram(sh->program);
+                sh->program = 0;
+            }
+        }
+        free(data);
+    }
+    fclose(f);
+    return ok;
+}
+
+static void save_shader_binary(struct shader_registry * reg, struct shader * sh) {
+    char path[512];
+    unsigned int header[3];
+    GLint length = 0;
+    GLenum format = 0;
+
+    glGetProgramiv(sh->program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if(length <= 0) return;
+
+    void * data = malloc(length);
+    glGetProgramBinary(sh->program, length, &length, &format, data);
+
+    shader_cache_path(reg, sh, path, sizeof(path));
+    FILE * f = fopen(path, "wb");
+    if(f != NULL) {
+        header[0] = SHADER_CACHE_MAGIC;
+        header[1] = format;
+        header[2] = length;
+        if(fwrite(header, sizeof(header), 1, f) == 1 && fwrite(data, length, 1, f) == 1) reg->saved++;
+        fclose(f);
+    } else {
+        printf("shader cache: could not write %s\n", path);
+    }
+    free(data);
+}
+
+// every active uniform outside a block -> map
+static void map_shader_locs(struct shader * sh) {
+    GLint count = 0;
+    glGetProgramiv(sh->program, GL_ACTIVE_UNIFORMS, &count);
+
+    sh->loc_count = 0;
+    for(GLint i = 0; i < count && sh->loc_count < SHADER_LOC_MAX; i++) {
+        char name[128];
+        GLsizei len = 0;
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(sh->program, i, sizeof(name), &len, &size, &type, name);
+        if(len <= 0) continue;
+
+        GLint loc = glGetUniformLocation(sh->program, name);
+        if(loc < 0) continue; // in a uniform block
+
+        sh->loc_tags[sh->loc_count] = hash_uniform_name(name);
+        sh->locs[sh->loc_count] = loc;
+        sh->loc_count++;
+    }
+}
+
+// -1 when the program has no such uniform (like glGetUniformLocation)
+GLint shader_loc(struct shader * sh, const char * name) {
+    unsigned int h = hash_uniform_name(name);
+    for(int i = 0; i < sh->loc_count; i++) {
+        if(sh->loc_tags[i] == h) return sh->locs[i];
+    }
+    return -1;
+}
+
+// builds or loads the program, the returned shader lives as long as the registry
+struct shader * get_shader(struct shader_registry * reg, const char * tag,
+                            const char * vertex_shader_src, const char * fragment_shader_src) {
+    unsigned long long int start = get_time_us();
+
+    if(reg->count == SHADER_MAX) {
+        printf("shader registry full, %s not added\n", tag);
+        return NULL;
+    }
+
+    struct shader * sh = &reg->shaders[reg->count];
+    memset(sh, 0, sizeof(struct shader));
+    sh->id = reg->count++;
+    sh->tag = strdup(tag);
+
+    unsigned long long int h = hash_shader_str(reg->driver_hash, vertex_shader_src);
+    h = hash_shader_str(h ^ 0x9e3779b97f4a7c15ull, fragment_shader_src);
+    sh->hash = h;
+
+    if(reg->cache_dir && load_shader_binary(reg, sh)) {
+        sh->from_cache = 1;
+        reg->loaded++;
+    } else {
+        printf("* compile %s shader\n", tag);
+        sh->program = build_shader_program_ex(vertex_shader_src, fragment_shader_src, reg->cache_dir != NULL);
+        reg->compiled++;
+        if(reg->cache_dir) save_shader_binary(reg, sh);
+    }
+
+    map_shader_locs(sh);
+    reg->build_us += get_time_us() - start;
+    return sh;
+}
+
+void free_shader_registry(struct shader_registry * reg) {
+    for(int i = 0; i < reg->count; i++) {
+        glDeleteProgram(reg->shaders[i].program);
+        free(reg->shaders[i].tag);
+        reg->shaders[i].program = 0;
+        reg->shaders[i].tag = NULL;
+    }
+}
+
+void print_shader_registry(struct shader_registry * reg) {
+    printf("shaders:    %9d programs, %d compiled, %d from cache, %d saved, %'llu us to build\n",
+            reg->count, reg->compiled, reg->loaded, reg->saved, reg->build_us);
+}
+
+#endif /* STG_SHADER_H */
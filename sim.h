@@ -0,0 +1,228 @@
+#ifndef STG_SIM_H
+#define STG_SIM_H
+
+#include <math.h>
+#include <string.h>
+
+#include "mat4.h"
+
+#ifndef A2R
+#define A2R		(0.01745329252f)
+#endif
+
+/*
+    fixed timestep simulation:
+        the sim always steps with the same dt (tick), independent of fps
+        each frame adds the measured frame time to an accumulator and runs
+        as many ticks as fit, capped so a long stall does not spiral
+        render state is interpolated between the last two sim states
+        with alpha = leftover accumulator / tick
+*/
+
+// action slots read by the sim, same order as the input action mapping
+enum sim_action {
+    SA_LEFT = 0,
+    SA_RIGHT,
+    SA_DOWN,
+    SA_UP,
+    SA_FIRE,
+
+    SA_MAX
+};
+
+#define PLAYER_TURN_RATE    4.0f    // rad / s
+
+struct player_s {
+    vec3 pos;
+    vec3 vel;
+    vec3 rot;
+};
+
+/*
+    spears:
+        fast projectiles, fired from the player tip
+        tick_sim only spawns / ages them, they are moved by step_spears()
+        (collision.h) because the move has to be swept against the world
+*/
+#define MAX_SPEARS          32
+#define SPEAR_SPEED         24.0f   // units / s, ~0.4 per tick at 60 Hz
+#define SPEAR_LIFE          2.0f    // s
+#define SPEAR_RADIUS        0.05f
+#define SPEAR_LENGTH        0.4f
+#define SPEAR_COOLDOWN      0.2f    // s between shots
+
+struct spear_s {
+    vec3 pos;   // tip
+    vec3 vel;
+    float life; // <= 0 -> unused
+};
+
+struct sim_state {
+    unsigned long long int tick;
+    struct player_s player;
+
+    float fire_cooldown;
+    struct spear_s spears[MAX_SPEARS];
+};
+
+struct sim_clock {
+    unsigned long long int tick_us;
+    unsigned long long int accumulator;  // us
+    int max_ticks;                       // catch-up cap per frame
+
+    float dt;                            // tick in seconds
+
+    // stats
+    unsigned long long int ticks;
+    unsigned long long int dropped_us;   // time thrown away by the cap
+    int capped_frames;
+};
+
+// ticks per second, above this a tick would be shorter than 1 us
+#define SIM_MAX_TICK_RATE   1000000
+
+void init_sim_clock(struct sim_clock * c, float tick_rate, int max_ticks) {
+    c->tick_us = (unsigned long long int)(1000000.0f / tick_rate);
+    if(c->tick_us < 1) c->tick_us = 1; // advance_sim_clock() divides by it
+    c->dt = (float)c->tick_us / 1000000.0f;
+    c->accumulator = 0;
+    c->max_ticks = max_ticks;
+    c->ticks = 0;
+    c->dropped_us = 0;
+    c->capped_frames = 0;
+}
+
+// feed the measured frame time, returns how many ticks to run this frame
+int advance_sim_clock(struct sim_clock * c, unsigned long long int frame_us) {
+    int n;
+
+    c->accumulator += frame_us;
+    n = c->accumulator / c->tick_us;
+    if(n > c->max_ticks) {
+        // too far behind, drop whole ticks and keep the fraction for interpolation
+        unsigned long long int keep = c->accumulator % c->tick_us;
+        c->dropped_us += c->accumulator - keep - c->max_ticks * c->tick_us;
+        c->accumulator = keep + c->max_ticks * c->tick_us;
+        c->capped_frames++;
+        n = c->max_ticks;
+    }
+    c->accumulator -= n * c->tick_us;
+    c->ticks += n;
+    return n;
+}
+
+// 0..1, how far the render time is past the latest sim state
+float sim_clock_alpha(struct sim_clock * c) {
+    return (float)c->accumulator / (float)c->tick_us;
+}
+
+// player triangle in world units, same shape and scale as the rendered one
+#define PLAYER_SCALE    0.5f
+
+// corners of the player triangle, tri[3] = { tip, left, right }
+void get_player_triangle(struct player_s * p, vec3 tri[3]) {
+    static const float local[3][2] = { { 0.5f, 0.0f }, { -0.5f, 0.5f }, { -0.5f, -0.5f } };
+    float c = cosf(p->rot.z) * PLAYER_SCALE;
+    float s = sinf(p->rot.z) * PLAYER_SCALE;
+
+    for(int i = 0; i < 3; i++) {
+        tri[i].x = p->pos.x + local[i][0] * c - local[i][1] * s;
+        tri[i].y = p->pos.y + local[i][0] * s + local[i][1] * c;
+        tri[i].z = p->pos.z;
+    }
+}
+
+void init_sim_state(struct sim_state * s) {
+    s->tick = 0;
+    set_vec3(3.0f, 3.0f, -3.8f, &s->player.pos);
+    set_vec3(0.0f, 0.0f, 0.0f, &s->player.vel);
+    set_vec3(0.0f, 0.0f, A2R * -90.0f, &s->player.rot);
+
+    s->fire_cooldown = 0.0f;
+    memset(s->spears, 0, sizeof(s->spears));
+}
+
+// actions[SA_MAX], non-zero = held
+void tick_sim(struct sim_state * s, const int * actions, float dt) {
+    struct player_s * p = &s->player;
+
+    if(actions[SA_LEFT]) { p->rot.z += PLAYER_TURN_RATE * dt; }
+    if(actions[SA_RIGHT]) { p->rot.z -= PLAYER_TURN_RATE * dt; }
+    if(actions[SA_UP]) {
+        float rx = cos(p->rot.z);
+        float ry = sin(p->rot.z);
+
+        p->vel.x += rx * 4.0f * dt;
+        p->vel.y += ry * 4.0f * dt;
+    }
+
+    p->pos.x += p->vel.x * 4 * dt;
+    p->pos.y += p->vel.y * 4 * dt;
+    // damping
+    p->vel.x -= p->vel.x * 0.9 * dt;
+    p->vel.y -= p->vel.y * 0.9 * dt;
+
+    // spears: fire into a slot that was already free last tick, then age
+    if(s->fire_cooldown > 0.0f) s->fire_cooldown -= dt;
+    if(actions[SA_FIRE] && s->fire_cooldown <= 0.0f) {
+        for(int i = 0; i < MAX_SPEARS; i++) {
+            struct spear_s * sp = &s->spears[i];
+            if(sp->life > 0.0f) continue;
+
+            vec3 tri[3];
+            get_player_triangle(p, tri);
+            sp->pos = tri[0];
+            sp->vel.x = cosf(p->rot.z) * SPEAR_SPEED + p->vel.x * 4.0f;
+            sp->vel.y = sinf(p->rot.z) * SPEAR_SPEED + p->vel.y * 4.0f;
+            sp->vel.z = 0.0f;
+            sp->life = SPEAR_LIFE;
+            s->fire_cooldown = SPEAR_COOLDOWN;
+            break;
+        }
+    }
+    for(int i = 0; i < MAX_SPEARS; i++) {
+        if(s->spears[i].life > 0.0f) s->spears[i].life -= dt;
+    }
+
+    s->tick++;
+}
+
+static inline float lerpf(float a, float b, float t) {
+    return a + (b - a) * t;
+}
+
+void lerp_vec3(vec3 * a, vec3 * b, float t, vec3 * c) {
+    c->x = lerpf(a->x, b->x, t);
+    c->y = lerpf(a->y, b->y, t);
+    c->z = lerpf(a->z, b->z, t);
+}
+
+/*
+    late latch, render only: turn the shown player as if the latched actions
+    had been held for dt instead of the ones the sim ran with
+    turning only, it is what shows right away, moves need ticks to add up
+*/
+void latch_player(struct player_s * p, const int * used, const int * latched, float dt) {
+    int turn_used = (used[SA_LEFT] != 0) - (used[SA_RIGHT] != 0);
+    int turn_latched = (latched[SA_LEFT] != 0) - (latched[SA_RIGHT] != 0);
+    p->rot.z += (turn_latched - turn_used) * PLAYER_TURN_RATE * dt;
+}
+
+// render state between prev and curr
+void lerp_sim_state(struct sim_state * prev, struct sim_state * curr, float alpha, struct sim_state * out) {
+    out->tick = curr->tick;
+    lerp_vec3(&prev->player.pos, &curr->player.pos, alpha, &out->player.pos);
+    lerp_vec3(&prev->player.vel, &curr->player.vel, alpha, &out->player.vel);
+    lerp_vec3(&prev->player.rot, &curr->player.rot, alpha, &out->player.rot);
+
+    out->fire_cooldown = curr->fire_cooldown;
+    for(int i = 0; i < MAX_SPEARS; i++) {
+        out->spears[i] = curr->spears[i];
+        // fresh spears have no previous position to blend from
+        if(curr->spears[i].life > 0.0f && prev->spears[i].life > 0.0f) {
+            lerp_vec3(&prev->spears[i].pos, &curr->spears[i].pos, alpha, &out->spears[i].pos);
+        }
+    }
+}
+
+#endif /* STG_SIM_H */
@@ -0,0 +1,196 @@
+#ifndef STG_SNAKES_H
+#define STG_SNAKES_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "verlet.h"
+#include "jobs.h"
+
+/*
+    snakes:
+        N snakes x M segments, built from a seed so every run is the same scene
+        heads wander around the arena, the body is a verlet chain (verlet.h)
+        pulled along by the head
+
+    layout:
+        segment-major SoA, value of segment s of snake i is at [s * stride + i]
+        stride is the snake count padded to SNAKE_LANES so the same segment of
+        neighbouring snakes sits next to each other (simd friendly)
+        px / py are the verlet previous positions, after a tick they hold
+        the previous tick which is also what render interpolation needs
+*/
+
+#define SNAKE_LANES     8
+
+#define ARENA_HALF_W    4.0f
+#define ARENA_HALF_H    3.0f
+
+struct snakes {
+    int count;      // snakes
+    int segments;   // per snake
+    int stride;     // count rounded up to SNAKE_LANES
+
+    float * x, * y;
+    float * px, * py;
+
+    // per snake
+    float * heading;
+    float * phase;
+
+    float seg_dist;
+    float speed;
+    float damping;      // verlet velocity kept per tick
+    int iterations;     // constraint relaxation passes per tick
+    float time;
+};
+
+static inline unsigned int snake_rand(unsigned int * seed) {
+    *seed = *seed * 1664525u + 1013904223u;
+    return *seed >> 8;
+}
+
+// 0..1
+static inline float snake_randf(unsigned int * seed) {
+    return (float)snake_rand(seed) / (float)(1u << 24);
+}
+
+void init_snakes(struct snakes * s, int count, int segments, unsigned int seed) {
+    size_t n;
+
+    s->count = count;
+    s->segments = segments;
+    s->stride = (count + SNAKE_LANES - 1) / SNAKE_LANES * SNAKE_LANES;
+    s->seg_dist = 0.35f;
+    s->speed = 1.5f;
+    s->damping = 0.9f;
+    s->iterations = 4;
+    s->time = 0.0f;
+
+    n = (size_t)s->stride * segments;
+    s->x = aligned_alloc(32, sizeof(float) * n);
+    s->y = aligned_alloc(32, sizeof(float) * n);
+    s->px = aligned_alloc(32, sizeof(float) * n);
+    s->py = aligned_alloc(32, sizeof(float) * n);
+    s->heading = aligned_alloc(32, sizeof(float) * s->stride);
+    s->phase = aligned_alloc(32, sizeof(float) * s->stride);
+
+    // padding lanes stay at 0 and are simulated like the rest, never drawn
+    memset(s->x, 0, sizeof(float) * n);
+    memset(s->y, 0, sizeof(float) * n);
+    memset(s->heading, 0, sizeof(float) * s->stride);
+    memset(s->phase, 0, sizeof(float) * s->stride);
+
+    for(int i = 0; i < count; i++) {
+        float hx = (snake_randf(&seed) * 2.0f - 1.0f) * ARENA_HALF_W;
+        float hy = (snake_randf(&seed) * 2.0f - 1.0f) * ARENA_HALF_H;
+        float a = snake_randf(&seed) * 6.2831853f;
+
+        s->heading[i] = a;
+        s->phase[i] = snake_randf(&seed) * 6.2831853f;
+
+        // body laid out straight behind the head
+        for(int j = 0; j < segments; j++) {
+            s->x[j * s->stride + i] = hx - cosf(a) * s->seg_dist * j;
+            s->y[j * s->stride + i] = hy - sinf(a) * s->seg_dist * j;
+        }
+    }
+
+    memcpy(s->px, s->x, sizeof(float) * n);
+    memcpy(s->py, s->y, sizeof(float) * n);
+}
+
+void free_snakes(struct snakes * s) {
+    free(s->x);
+    free(s->y);
+    free(s->px);
+    free(s->py);
+    free(s->heading);
+    free(s->phase);
+    memset(s, 0, sizeof(struct snakes));
+}
+
+// size of segment j, head is 1
+static inline float snake_segment_scale(struct snakes * s, int j) {
+    return 1.0f - ((float)j / s->segments);
+}
+
+// snakes [i0, i1) only, i0 / i1 multiples of SNAKE_LANES, s->time already advanced
+void tick_snakes_range(struct snakes * s, float dt, int i0, int i1) {
+    int stride = s->stride;
+    int lanes = i1 - i0;
+
+    // all points: x += (x - px) * damping, px = x
+    if(lanes == stride) {
+        verlet_integrate(s->x, s->y, s->px, s->py, stride * s->segments, s->damping);
+    } else {
+        for(int j = 0; j < s->segments; j++) {
+            int k = j * stride + i0;
+            verlet_integrate(s->x + k, s->y + k, s->px + k, s->py + k, lanes, s->damping);
+        }
+    }
+
+    // heads: kinematic, wander, turn back towards the middle when outside the arena
+    for(int i = i0; i < i1; i++) {
+        float hx = s->px[i];
+        float hy = s->py[i];
+        float turn = sinf(s->time * 0.7f + s->phase[i]) * 2.0f;
+
+        if(hx < -ARENA_HALF_W || hx > ARENA_HALF_W || hy < -ARENA_HALF_H || hy > ARENA_HALF_H) {
+            float to_center = atan2f(-hy, -hx);
+            float d = remainderf(to_center - s->heading[i], 6.2831853f);
+            turn = d > 0.0f ? 3.0f : -3.0f;
+        }
+
+        s->heading[i] += turn * dt;
+        s->x[i] = hx + cosf(s->heading[i]) * s->speed * dt;
+        s->y[i] = hy + sinf(s->heading[i]) * s->speed * dt;
+    }
+
+    // body: keep seg_dist between neighbours, the head is pinned
+    verlet_relax_chains(s->x + i0, s->y + i0, stride, lanes, s->segments, s->seg_dist, s->iterations, 1);
+}
+
+void tick_snakes(struct snakes * s, float dt) {
+    s->time += dt;
+    tick_snakes_range(s, dt, 0, s->stride);
+}
+
+/*
+    parallel:
+        snakes are independent during the tick, so they are split into column
+        ranges of SNAKE_JOB_LANES (16 floats = one cache line per row, no false
+        sharing between jobs) and run as a parallel_for
+*/
+#define SNAKE_JOB_LANES     16
+
+struct snake_job_s {
+    struct snakes * s;
+    float dt;
+};
+
+static void tick_snakes_job(void * data, int begin, int end) {
+    struct snake_job_s * job = data;
+    int i0 = begin * SNAKE_JOB_LANES;
+    int i1 = end * SNAKE_JOB_LANES;
+    if(i1 > job->s->stride) i1 = job->s->stride;
+    tick_snakes_range(job->s, job->dt, i0, i1);
+}
+
+void tick_snakes_parallel(struct snakes * s, float dt, struct job_system * js) {
+    struct snake_job_s job = { s, dt };
+    int blocks = (s->stride + SNAKE_JOB_LANES - 1) / SNAKE_JOB_LANES;
+
+    s->time += dt;
+    parallel_for(js, 0, blocks, 0, tick_snakes_job, &job);
+}
+
+// render position of segment j of snake i, alpha blends previous -> current tick
+static inline void get_snake_segment(struct snakes * s, int i, int j, float alpha, float * x, float * y) {
+    int k = j * s->stride + i;
+    *x = s->px[k] + (s->x[k] - s->px[k]) * alpha;
+    *y = s->py[k] + (s->y[k] - s->py[k]) * alpha;
+}
+
+#endif /* STG_SNAKES_H */
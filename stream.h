@@ -0,0 +1,197 @@
+#ifndef STG_STREAM_H
+#define STG_STREAM_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <GL/glew.h>
+
+#include "glstate.h"
+
+/*
+    streaming buffer:
+        one big gl buffer used as a ring for geometry that changes every frame
+        (instances, debug lines, particles ..), split in STREAM_REGIONS regions,
+        a frame writes into one region only
+
+        per frame:
+            begin_stream_frame()    -> next region, waits on its fence
+            map_stream_buffer()     -> pointer to write + offset to draw from
+            unmap_stream_buffer()   -> before the draw that reads it
+            end_stream_frame()      -> fence after the frame's draws
+
+        mapped mode (gl 3.2 / ARB_sync + map_buffer_range):
+            ranges are mapped UNSYNCHRONIZED | INVALIDATE_RANGE, the driver does
+            no tracking, the fence per region is what keeps the cpu from writing
+            over data the gpu has not read yet
+            STREAM_REGIONS frames can be in flight before a wait
+        orphan mode (anything else):
+            writes go to a cpu copy and glBufferSubData, the buffer is orphaned
+            (glBufferData NULL) every time the ring wraps
+
+        a frame that does not fit its region grows the ring, the old storage is
+        orphaned so draws already issued keep reading it
+*/
+
+#define STREAM_REGIONS      3
+#define STREAM_ALIGN        256
+
+struct stream_buffer {
+    GLuint vbo;
+    GLenum target;
+    int mapped;             // 1 -> map + fences, 0 -> orphaning
+
+    size_t size;            // whole ring
+    size_t region_size;
+    int region;             // written this frame
+    size_t head;            // next free byte in the region
+    GLsync fences[STREAM_REGIONS];
+
+    // current map_stream_buffer() range
+    size_t map_offset, map_bytes;
+    char * staging;         // orphan mode only, [size]
+
+    // stats
+    unsigned long long int frames;
+    unsigned long long int bytes;           // total uploaded
+    unsigned long long int frame_bytes;     // this frame
+    unsigned long long int max_frame_bytes;
+    unsigned long long int waits;           // fences that were not signaled yet
+    unsigned long long int grows;
+};
+
+static void alloc_stream_buffer(struct stream_buffer * sb, size_t size) {
+    sb->region_size = (size / STREAM_REGIONS + STREAM_ALIGN - 1) / STREAM_ALIGN * STREAM_ALIGN;
+    sb->size = sb->region_size * STREAM_REGIONS;
+
+    gls_bind_buffer(sb->target, sb->vbo);
+    glBufferData(sb->target, sb->size, NULL, GL_STREAM_DRAW);
+
+    if(!sb->mapped) {
+        free(sb->staging);
+        sb->staging = malloc(sb->size);
+    }
+}
+
+static void delete_stream_fences(struct stream_buffer * sb) {
+    for(int i = 0; i < STREAM_REGIONS; i++) {
+        if(sb->fences[i]) glDeleteSync(sb->fences[i]);
+        sb->fences[i] = 0;
+    }
+}
+
+// size = whole ring in bytes, the first frame starts at region 0
+void init_stream_buffer(struct stream_buffer * sb, GLenum target, size_t size) {
+    memset(sb, 0, sizeof(struct stream_buffer));
+    sb->target = target;
+    sb->mapped = (GLEW_VERSION_3_2 || GLEW_ARB_sync) && (GLEW_VERSION_3_0 || GLEW_ARB_map_buffer_range);
+    sb->region = STREAM_REGIONS - 1;
+
+    glGenBuffers(1, &sb->vbo);
+    alloc_stream_buffer(sb, size);
+
+    printf("* stream buffer: %zu kb, %d regions, %s\n", sb->size / 1024, STREAM_REGIONS,
+            sb->mapped ? "mapped + fences" : "orphaning");
+}
+
+void free_stream_buffer(struct stream_buffer * sb) {
+    if(sb->mapped) delete_stream_fences(sb);
+    glDeleteBuffers(1, &sb->vbo);
+    free(sb->staging);
+    sb->staging = NULL;
+    sb->vbo = 0;
+}
+
+void begin_stream_frame(struct stream_buffer * sb) {
+    sb->region = (sb->region + 1) % STREAM_REGIONS;
+    sb->head = 0;
+    sb->frame_bytes = 0;
+
+    if(sb->mapped) {
+        GLsync fence = sb->fences[sb->region];
+        if(fence) {
+            GLenum r = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+            if(r == GL_TIMEOUT_EXPIRED) {
+                sb->waits++;
+                do {
+                    r = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+                } while(r == GL_TIMEOUT_EXPIRED);
+            }
+            glDeleteSync(fence);
+            sb->fences[sb->region] = 0;
+        }
+    } else if(sb->region == 0) {
+        // orphan, the gpu keeps the old storage for as long as it needs it
+        gls_bind_buffer(sb->target, sb->vbo);
+        glBufferData(sb->target, sb->size, NULL, GL_STREAM_DRAW);
+    }
+}
+
+/*
+    space for bytes at a multiple of align, *offset is where it is in the buffer
+    the pointer is valid until unmap_stream_buffer(), only one range is mapped at a time
+    the buffer stays bound to its target
+*/
+void * map_stream_buffer(struct stream_buffer * sb, size_t bytes, size_t align, size_t * offset) {
+    size_t head = (sb->head + align - 1) / align * align;
+
+    if(head + bytes > sb->region_size) {
+        // grow, keep the new region size well above this frame
+        size_t need = (head + bytes) * 2 * STREAM_REGIONS;
+        printf("stream buffer: %zu kb frame does not fit, growing to %zu kb\n",
+                (head + bytes) / 1024, need / 1024);
+        if(sb->mapped) delete_stream_fences(sb);
+        alloc_stream_buffer(sb, need);
+        sb->region = 0;
+        sb->grows++;
+        head = 0;
+    }
+
+    sb->map_offset = sb->region * sb->region_size + head;
+    sb->map_bytes = bytes;
+    sb->head = head + bytes;
+    sb->frame_bytes += bytes;
+    sb->bytes += bytes;
+    *offset = sb->map_offset;
+
+    gls_bind_buffer(sb->target, sb->vbo);
+    if(!sb->mapped) return sb->staging + sb->map_offset;
+
+    return glMapBufferRange(sb->target, sb->map_offset, bytes,
+                GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+}
+
+void unmap_stream_buffer(struct stream_buffer * sb) {
+    if(sb->mapped) {
+        glUnmapBuffer(sb->target);
+    } else {
+        glBufferSubData(sb->target, sb->map_offset, sb->map_bytes, sb->staging + sb->map_offset);
+    }
+}
+
+// copy in one go, returns the offset to draw from
+size_t upload_stream_buffer(struct stream_buffer * sb, const void * data, size_t bytes, size_t align) {
+    size_t offset;
+    void * dst = map_stream_buffer(sb, bytes, align, &offset);
+    if(dst) memcpy(dst, data, bytes);
+    unmap_stream_buffer(sb);
+    return offset;
+}
+
+// after the last draw reading from this frame's region
+void end_stream_frame(struct stream_buffer * sb) {
+    if(sb->mapped) {
+        sb->fences[sb->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    sb->frames++;
+    if(sb->frame_bytes > sb->max_frame_bytes) sb->max_frame_bytes = sb->frame_bytes;
+}
+
+void print_stream_buffer(struct stream_buffer * sb) {
+    unsigned long long int n = sb->frames ? sb->frames : 1;
+    printf("stream:     %'9llu bytes uploaded per frame (avg), %'llu max, %llu fence waits, %llu grows, %s\n",
+            sb->bytes / n, sb->max_frame_bytes, sb->waits, sb->grows, sb->mapped ? "mapped" : "orphaned");
+}
+
+#endif /* STG_STREAM_H */
@@ -0,0 +1,246 @@
+#ifndef STG_TARGET_H
+#define STG_TARGET_H
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <GL/glew.h>
+
+#include "mat4.h"
+#include "glstate.h"
+
+/*
+    render target:
+        the scene is drawn into an fbo of a fixed internal resolution (w x h),
+        independent of the window, then blitted to the window scaled to fit
+        with the aspect ratio kept, the rest is border (letterbox / pillarbox)
+
+        dynamic resolution only draws into the lower left view_w x view_h of
+        the fbo, the blit stretches that part, so a change costs nothing
+
+        no fbo support -> the scene is drawn straight into the letterboxed
+        viewport of the window, no scaling
+
+    dynres:
+        render time (TT_RENDER) is smoothed and compared to the budget,
+        over -> shrink the scale, well under -> grow it back slowly
+        pixels go with scale^2 so a step is sqrt(budget / time)
+        every change is followed by a few frames of cooldown so the new
+        size gets measured before the next one
+*/
+
+struct render_target {
+    GLuint fbo, color_tex, depth_rb;
+    int blitted;                // fbo was created, kept after free for the report
+    int w, h;                   // internal resolution
+    int view_w, view_h;         // part that is drawn, <= w, h
+
+    int win_w, win_h;           // drawable size of the window
+    int dst_x, dst_y, dst_w, dst_h; // where the view lands in the window
+
+    vec4 border_color;
+};
+
+#define DYNRES_STEP_MIN     0.03125f    // scale is kept a multiple of this
+
+struct dynres {
+    int enabled;
+    float scale, min_scale, max_scale;
+    unsigned long long int budget_us;
+    float avg_us;               // smoothed render time
+    int cooldown;               // frames until the next change
+
+    // stats
+    unsigned long long int changes;
+    float lowest;
+};
+
+int has_framebuffer_object(void) {
+    return GLEW_VERSION_3_0 || GLEW_ARB_framebuffer_object;
+}
+
+void init_render_target(struct render_target * t, int w, int h) {
+    memset(t, 0, sizeof(struct render_target));
+    t->w = t->view_w = w;
+    t->h = t->view_h = h;
+    t->win_w = t->dst_w = w;
+    t->win_h = t->dst_h = h;
+    set_rgb_vec4(0, 0, 0, &t->border_color);
+
+    if(!has_framebuffer_object()) {
+        printf("* no framebuffer objects, drawing to the window at its resolution\n");
+        return;
+    }
+
+    glGenTextures(1, &t->color_tex);
+    gls_bind_texture_2d(t->color_tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    gls_bind_texture_2d(0);
+
+    glGenRenderbuffers(1, &t->depth_rb);
+    glBindRenderbuffer(GL_RENDERBUFFER, t->depth_rb);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, w, h);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &t->fbo);
+    gls_bind_framebuffer(GL_FRAMEBUFFER, t->fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, t->color_tex, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, t->depth_rb);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    gls_bind_framebuffer(GL_FRAMEBUFFER, 0);
+
+    if(status != GL_FRAMEBUFFER_COMPLETE) {
+        printf("* render target %dx%d incomplete (0x%x), drawing to the window\n", w, h, status);
+        glDeleteFramebuffers(1, &t->fbo);
+        glDeleteRenderbuffers(1, &t->depth_rb);
+        glDeleteTextures(1, &t->color_tex);
+        t->fbo = t->depth_rb = t->color_tex = 0;
+        return;
+    }
+    t->blitted = 1;
+    printf("* render target %dx%d\n", w, h);
+}
+
+void free_render_target(struct render_target * t) {
+    if(t->fbo) {
+        glDeleteFramebuffers(1, &t->fbo);
+        glDeleteRenderbuffers(1, &t->depth_rb);
+        glDeleteTextures(1, &t->color_tex);
+    }
+    t->fbo = t->depth_rb = t->color_tex = 0;
+}
+
+// window drawable size, fits w x h into it keeping the aspect ratio, centered
+void resize_render_target(struct render_target * t, int win_w, int win_h) {
+    if(win_w < 1) win_w = 1;
+    if(win_h < 1) win_h = 1;
+    t->win_w = win_w;
+    t->win_h = win_h;
+
+    // compare w / h against win_w / win_h without dividing
+    if((long long int)win_w * t->h > (long long int)win_h * t->w) {
+        // window is wider -> bars left and right
+        t->dst_h = win_h;
+        t->dst_w = (int)((long long int)win_h * t->w / t->h);
+    } else {
+        t->dst_w = win_w;
+        t->dst_h = (int)((long long int)win_w * t->h / t->w);
+    }
+    t->dst_x = (win_w - t->dst_w) / 2;
+    t->dst_y = (win_h - t->dst_h) / 2;
+}
+
+// scale of the internal resolution, 1 -> all of it
+void set_render_target_scale(struct render_target * t, float scale) {
+    t->view_w = (int)(t->w * scale + 0.5f);
+    t->view_h = (int)(t->h * scale + 0.5f);
+    if(t->view_w < 1) t->view_w = 1;
+    if(t->view_h < 1) t->view_h = 1;
+    if(t->view_w > t->w) t->view_w = t->w;
+    if(t->view_h > t->h) t->view_h = t->h;
+}
+
+// binds the target + viewport and clears it with clear_color
+void begin_render_target(struct render_target * t, vec4 * clear_color) {
+    if(t->fbo) {
+        gls_bind_framebuffer(GL_FRAMEBUFFER, t->fbo);
+        gls_viewport(0, 0, t->view_w, t->view_h);
+        gls_clear_color(clear_color->x, clear_color->y, clear_color->z, clear_color->w);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        return;
+    }
+
+    // borders first, then only the view
+    gls_bind_framebuffer(GL_FRAMEBUFFER, 0);
+    gls_viewport(0, 0, t->win_w, t->win_h);
+    gls_clear_color(t->border_color.x, t->border_color.y, t->border_color.z, t->border_color.w);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    gls_viewport(t->dst_x, t->dst_y, t->dst_w, t->dst_h);
+    gls_set_cap(GL_SCISSOR_TEST, 1);
+    glScissor(t->dst_x, t->dst_y, t->dst_w, t->dst_h);
+    gls_clear_color(clear_color->x, clear_color->y, clear_color->z, clear_color->w);
+    glClear(GL_COLOR_BUFFER_BIT);
+    gls_set_cap(GL_SCISSOR_TEST, 0);
+}
+
+/*
+    view -> letterboxed rect of the window, leaves the window bound
+    TODO: option for an edge texture instead of a flat border
+*/
+void present_render_target(struct render_target * t) {
+    if(!t->fbo) return;
+
+    gls_bind_framebuffer(GL_READ_FRAMEBUFFER, t->fbo);
+    gls_bind_framebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    gls_viewport(0, 0, t->win_w, t->win_h);
+    gls_clear_color(t->border_color.x, t->border_color.y, t->border_color.z, t->border_color.w);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    // 1:1 stays sharp, anything else is filtered
+    GLenum filter = (t->view_w == t->dst_w && t->view_h == t->dst_h) ? GL_NEAREST : GL_LINEAR;
+    glBlitFramebuffer(0, 0, t->view_w, t->view_h,
+                        t->dst_x, t->dst_y, t->dst_x + t->dst_w, t->dst_y + t->dst_h,
+                        GL_COLOR_BUFFER_BIT, filter);
+    gls_bind_framebuffer(GL_READ_FRAMEBUFFER, 0);
+}
+
+void init_dynres(struct dynres * d, int enabled, unsigned long long int budget_us) {
+    memset(d, 0, sizeof(struct dynres));
+    d->enabled = enabled;
+    d->scale = 1.0f;
+    d->min_scale = 0.25f;
+    d->max_scale = 1.0f;
+    d->budget_us = budget_us;
+    d->avg_us = 0.0f;
+    d->cooldown = 30;
+    d->lowest = 1.0f;
+}
+
+// feed the last frame's render time, returns 1 when the scale changed
+int update_dynres(struct dynres * d, unsigned long long int render_us) {
+    if(!d->enabled) return 0;
+
+    d->avg_us = d->avg_us > 0.0f ? d->avg_us * 0.9f + render_us * 0.1f : (float)render_us;
+    if(d->cooldown > 0) {
+        d->cooldown--;
+        return 0;
+    }
+
+    float budget = (float)d->budget_us;
+    float scale = d->scale;
+    if(d->avg_us > budget) {
+        // down fast, at most half the pixels per step
+        float step = sqrtf(budget / d->avg_us);
+        scale *= step > 0.7f ? step : 0.7f;
+    } else if(d->avg_us < budget * 0.7f) {
+        // up slow, avoids bouncing around the budget
+        scale += 0.05f;
+    }
+
+    scale = floorf(scale / DYNRES_STEP_MIN + 0.5f) * DYNRES_STEP_MIN;
+    if(scale < d->min_scale) scale = d->min_scale;
+    if(scale > d->max_scale) scale = d->max_scale;
+    if(scale == d->scale) return 0;
+
+    d->scale = scale;
+    d->changes++;
+    if(scale < d->lowest) d->lowest = scale;
+    d->cooldown = 15;
+    return 1;
+}
+
+void print_dynres(struct dynres * d, struct render_target * t) {
+    printf("target:     %9dx%d internal, %dx%d at exit, %s\n", t->w, t->h, t->view_w, t->view_h,
+            t->blitted ? "blitted" : "no fbo");
+    if(d->enabled) {
+        printf("dynres:     %9.2f scale at exit, %.2f lowest, %llu changes, budget %llu us, avg %.0f us\n",
+                d->scale, d->lowest, d->changes, d->budget_us, d->avg_us);
+    }
+}
+
+#endif /* STG_TARGET_H */
@@ -1,6 +1,6 @@
-
 // linux/bsd - _GNU_SOURCE
 #include <time.h>
+#include <errno.h>
 int clock_gettime (clockid_t __clock_id, struct timespec *__tp);
 int clock_nanosleep (clockid_t __clock_id, int __flags, const struct timespec *__req, struct timespec *__rem);
 
@@ -15,17 +15,18 @@ unsigned long long int get_time_us(void) {
 	return time;
 }
 
+unsigned long long int get_time_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	
+	return (unsigned long long int)ts.tv_sec * 1000000000 + (unsigned long long int)ts.tv_nsec;
+}
+
 static inline void sleep_ns(unsigned long long int ns) {
 	struct timespec req;
 	
-	/* get seconds */
-	req.tv_sec = 0;
-	while(ns > 1000000000) {
-		req.tv_sec++;
-		ns -= 1000000000;
-	}
-	/* get nanoseconds */
-	req.tv_nsec = ns;
+	req.tv_sec = ns / 1000000000;
+	req.tv_nsec = ns % 1000000000;
 
 	clock_nanosleep(CLOCK_MONOTONIC, 0, &req, NULL);
 }
@@ -33,3 +34,145 @@ static inline void sleep_ns(unsigned long long int ns) {
 static inline void sleep_us(unsigned long long int us) {
 	sleep_ns(us * 1000);
 }
+
+/* sleep until an absolute CLOCK_MONOTONIC time (same base as get_time_ns) */
+static inline void sleep_until_ns(unsigned long long int deadline) {
+	struct timespec req;
+	
+	req.tv_sec = deadline / 1000000000;
+	req.tv_nsec = deadline % 1000000000;
+
+	/* restart if a signal cuts the sleep short, the deadline does not move
+	   any other error returns early, the caller's spin finishes the wait */
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &req, NULL) == EINTR) {}
+}
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+}
+
+/*
+	frame pacer:
+		frame starts sit on a fixed grid (start + n * period), not "now + what is left"
+		so sleep overshoot in one frame is not carried into the next one.
+
+		the wait sleeps (TIMER_ABSTIME) until deadline - margin and spins the rest.
+		margin = max(spin_ns, learned oversleep mean + 4 * mean deviation), so on a
+		system with sloppy wakeups we spin a bit longer instead of waking late.
+
+		if a frame overruns its deadline the missed grid slots are skipped.
+
+	late input:
+		the grid is where the frame should be done (swap) instead of where it
+		starts, the wait ends lead_ns early so input is read as late as
+		possible and the work of the frame runs right up to the grid.
+		lead = expected work (jumps up to slow frames, decays back over ~16
+		frames) + spin_ns, fed by feed_frame_pacer_work()
+*/
+struct frame_pacer {
+	unsigned long long int period_ns;
+	unsigned long long int next;		/* absolute deadline of the next frame start */
+	unsigned long long int spin_ns;		/* minimum spin window */
+
+	/* learned oversleep of clock_nanosleep, ns */
+	double oversleep_avg;
+	double oversleep_dev;
+	unsigned long long int oversleep_max;
+
+	/* achieved pacing: wake time - deadline, ns */
+	unsigned long long int frames;
+	unsigned long long int missed;
+	double jitter_sum;
+	double jitter_sq_sum;
+	unsigned long long int jitter_max;
+
+	unsigned long long int spun_ns;
+
+	/* late input, 0 -> frames start on the grid */
+	unsigned long long int lead_ns;
+	double work_est;
+};
+
+void init_frame_pacer(struct frame_pacer * p, unsigned long long int period_ns, unsigned long long int spin_ns) {
+	p->period_ns = period_ns;
+	p->next = get_time_ns() + period_ns;
+	p->spin_ns = spin_ns;
+
+	p->oversleep_avg = 0.0;
+	p->oversleep_dev = 0.0;
+	p->oversleep_max = 0;
+
+	p->frames = 0;
+	p->missed = 0;
+	p->jitter_sum = 0.0;
+	p->jitter_sq_sum = 0.0;
+	p->jitter_max = 0;
+
+	p->spun_ns = 0;
+
+	p->lead_ns = 0;
+	p->work_est = 0.0;
+}
+
+static inline unsigned long long int frame_pacer_margin(struct frame_pacer * p) {
+	unsigned long long int margin = (unsigned long long int)(p->oversleep_avg + 4.0 * p->oversleep_dev);
+	if(margin < p->spin_ns) margin = p->spin_ns;
+	if(margin > p->period_ns / 2) margin = p->period_ns / 2;
+	return margin;
+}
+
+/* late input: work_ns = input + update + render of the last frame */
+void feed_frame_pacer_work(struct frame_pacer * p, unsigned long long int work_ns) {
+	if(work_ns > p->work_est) p->work_est = (double)work_ns;
+	else p->work_est += ((double)work_ns - p->work_est) / 16.0;
+
+	p->lead_ns = (unsigned long long int)p->work_est + p->spin_ns;
+	if(p->lead_ns > p->period_ns * 3 / 4) p->lead_ns = p->period_ns * 3 / 4;
+}
+
+/* wait for the next frame start, returns how late the frame was (ns, 0 = on time) */
+unsigned long long int wait_frame_pacer(struct frame_pacer * p) {
+	unsigned long long int now = get_time_ns();
+	unsigned long long int late = 0;
+	unsigned long long int deadline = p->next - p->lead_ns;
+
+	if(now >= deadline) {
+		/* overrun - skip the missed slots and start right away */
+		late = now - deadline;
+		p->missed++;
+		p->next += p->period_ns * (late / p->period_ns + 1);
+		return late;
+	}
+
+	unsigned long long int margin = frame_pacer_margin(p);
+	if(deadline - now > margin) {
+		unsigned long long int wake_at = deadline - margin;
+		sleep_until_ns(wake_at);
+
+		/* learn how far past the requested wakeup the scheduler lets us run */
+		now = get_time_ns();
+		unsigned long long int over = now > wake_at ? now - wake_at : 0;
+		double diff = (double)over - p->oversleep_avg;
+		p->oversleep_avg += diff / 16.0;
+		p->oversleep_dev += ((diff < 0 ? -diff : diff) - p->oversleep_dev) / 16.0;
+		if(over > p->oversleep_max) p->oversleep_max = over;
+	}
+
+	unsigned long long int spin_start = now;
+	while(now < deadline) {
+		cpu_relax();
+		now = get_time_ns();
+	}
+	p->spun_ns += now - spin_start;
+
+	unsigned long long int jitter = now - deadline;
+	p->frames++;
+	p->jitter_sum += (double)jitter;
+	p->jitter_sq_sum += (double)jitter * (double)jitter;
+	if(jitter > p->jitter_max) p->jitter_max = jitter;
+
+	p->next += p->period_ns;
+	return 0;
+}
@@ -0,0 +1,328 @@
+#ifndef STG_TIMING_H
+#define STG_TIMING_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+// TODO: make timings use a proper timestruct (start, end, elapsed, { ns, us, ms, s, mm, hh, dd, yy })
+// along with a nice printout and format function
+
+// for timings
+enum time_tag {
+    TT_INIT = 0,
+    TT_DEINIT,
+    TT_INPUT,
+    TT_COMPUTE,
+    TT_RENDER,
+    TT_SLEEP,
+
+    TT_MAX
+};
+const char * time_tag_name[TT_MAX] = { "Startup", "Cleanup", "Input", "Update", "Render", "Sleep" };
+
+// per frame stages, the ones that go in the frame series
+#define TT_FRAME_FIRST  TT_INPUT
+#define TT_FRAME_LAST   TT_SLEEP
+
+// gpu time of the render passes (gputimer.h), arrives a few frames late
+enum gpu_tag {
+    GT_SCENE = 0,
+    GT_BLIT,
+
+    GT_MAX
+};
+const char * gpu_tag_name[GT_MAX] = { "GPU Scene", "GPU Blit" };
+
+/*
+    per-frame timing series:
+        bounded ring buffer, one sample per frame
+        once full the oldest frames are overwritten
+        used for percentiles / histogram at exit and for csv / json export
+*/
+
+struct frame_sample_s {
+    unsigned long long int frame;
+    unsigned int t[TT_MAX];     // us per stage
+    unsigned int total;         // us, wall time frame start -> next frame start
+    unsigned int latency;       // us, input read -> swap of the frame showing it, 0 = not measured
+    unsigned int key_latency;   // us, first key event (sdl timestamp) -> swap of the frame showing it, 0 = no key
+    unsigned int gpu[GT_MAX];   // us per render pass on the gpu
+    int gpu_measured;
+};
+
+struct frame_timings {
+    int cap;
+    int head;   // next write
+    int count;
+    struct frame_sample_s * samples;
+};
+
+#define FRAME_TIMINGS_DEFAULT_CAP   (1 << 16) // ~18 min at 60 fps
+
+void init_frame_timings(struct frame_timings * ft, int cap) {
+    ft->cap = cap;
+    ft->head = 0;
+    ft->count = 0;
+    ft->samples = malloc(sizeof(struct frame_sample_s) * cap);
+}
+
+void free_frame_timings(struct frame_timings * ft) {
+    free(ft->samples);
+    ft->samples = NULL;
+    ft->cap = ft->head = ft->count = 0;
+}
+
+// returns a zeroed sample for the frame, valid until the ring wraps around
+struct frame_sample_s * push_frame_timings(struct frame_timings * ft, unsigned long long int frame) {
+    struct frame_sample_s * fs = &ft->samples[ft->head];
+    memset(fs, 0, sizeof(struct frame_sample_s));
+    fs->frame = frame;
+
+    ft->head = (ft->head + 1) % ft->cap;
+    if(ft->count < ft->cap) ft->count++;
+    return fs;
+}
+
+// i = 0 is the oldest frame kept
+struct frame_sample_s * get_frame_timings(struct frame_timings * ft, int i) {
+    int oldest = (ft->head - ft->count + ft->cap) % ft->cap;
+    return &ft->samples[(oldest + i) % ft->cap];
+}
+
+// sample of a recent frame, NULL when it is not in the ring (anymore)
+struct frame_sample_s * find_frame_timings(struct frame_timings * ft, unsigned long long int frame) {
+    // newest first, the ones asked for are only a few frames old
+    for(int i = ft->count - 1; i >= 0; i--) {
+        struct frame_sample_s * fs = get_frame_timings(ft, i);
+        if(fs->frame == frame) return fs;
+        if(fs->frame < frame) break;
+    }
+    return NULL;
+}
+
+static int cmp_uint(const void * a, const void * b) {
+    unsigned int x = *(const unsigned int *)a;
+    unsigned int y = *(const unsigned int *)b;
+    return (x > y) - (x < y);
+}
+
+// nearest-rank percentile of an already sorted array
+unsigned int percentile_sorted(unsigned int * sorted, int n, float p) {
+    if(n <= 0) return 0;
+    int rank = (int)ceilf(p / 100.0f * n);
+    if(rank < 1) rank = 1;
+    if(rank > n) rank = n;
+    return sorted[rank - 1];
+}
+
+void print_percentile_row(const char * name, unsigned int * values, int n) {
+    qsort(values, n, sizeof(unsigned int), cmp_uint);
+    printf("  %-9s %'9u %'9u %'9u %'9u us\n", name,
+            percentile_sorted(values, n, 50.0f),
+            percentile_sorted(values, n, 90.0f),
+            percentile_sorted(values, n, 99.0f),
+            n > 0 ? values[n - 1] : 0);
+}
+
+void print_frame_timings(struct frame_timings * ft, unsigned long long int max_frame_time) {
+    int n = ft->count;
+    if(n == 0) return;
+
+    unsigned int * values = malloc(sizeof(unsigned int) * n);
+
+    printf("\nFrame timings (last %d frames):\n", n);
+    printf("  %-9s %9s %9s %9s %9s\n", "", "p50", "p90", "p99", "max");
+    for(int tag = TT_FRAME_FIRST; tag <= TT_FRAME_LAST; tag++) {
+        for(int i = 0; i < n; i++) values[i] = get_frame_timings(ft, i)->t[tag];
+        print_percentile_row(time_tag_name[tag], values, n);
+    }
+    {
+        // only frames that were presented
+        int m = 0;
+        for(int i = 0; i < n; i++) {
+            unsigned int l = get_frame_timings(ft, i)->latency;
+            if(l) values[m++] = l;
+        }
+        if(m) print_percentile_row("Latency", values, m);
+
+        // only frames that showed a key event
+        m = 0;
+        for(int i = 0; i < n; i++) {
+            unsigned int l = get_frame_timings(ft, i)->key_latency;
+            if(l) values[m++] = l;
+        }
+        if(m) print_percentile_row("Key Lat", values, m);
+    }
+    for(int tag = 0; tag < GT_MAX; tag++) {
+        int m = 0;
+        for(int i = 0; i < n; i++) {
+            struct frame_sample_s * fs = get_frame_timings(ft, i);
+            if(fs->gpu_measured) values[m++] = fs->gpu[tag];
+        }
+        if(m) print_percentile_row(gpu_tag_name[tag], values, m);
+    }
+    for(int i = 0; i < n; i++) values[i] = get_frame_timings(ft, i)->total;
+    print_percentile_row("Frame", values, n);
+
+    // histogram of total frame time, values[] is sorted from the last row
+    // buckets are 1/4 of the frame budget, the last one catches everything above 2x budget
+    #define FT_HIST_BUCKETS 9
+    int hist[FT_HIST_BUCKETS];
+    int hist_max = 0;
+    unsigned long long int bucket_us = max_frame_time / 4;
+    if(bucket_us == 0) bucket_us = 1;
+
+    memset(hist, 0, sizeof(hist));
+    for(int i = 0; i < n; i++) {
+        unsigned long long int b = values[i] / bucket_us;
+        if(b >= FT_HIST_BUCKETS) b = FT_HIST_BUCKETS - 1;
+        hist[b]++;
+    }
+    for(int b = 0; b < FT_HIST_BUCKETS; b++) {
+        if(hist[b] > hist_max) hist_max = hist[b];
+    }
+
+    printf("\nFrame time histogram (budget %llu us):\n", max_frame_time);
+    for(int b = 0; b < FT_HIST_BUCKETS; b++) {
+        int bar = hist_max ? (hist[b] * 40 + hist_max - 1) / hist_max : 0;
+        if(b < FT_HIST_BUCKETS - 1) {
+            printf("  %6llu - %6llu us %'8d |", b * bucket_us, (b + 1) * bucket_us, hist[b]);
+        } else {
+            printf("  %6llu +         us %'8d |", b * bucket_us, hist[b]);
+        }
+        for(int i = 0; i < bar; i++) putchar('#');
+        putchar('\n');
+    }
+    #undef FT_HIST_BUCKETS
+
+    free(values);
+}
+
+/*
+    export the raw series, format is picked from the file extension:
+        .json -> { "frame": [...], "Input": [...], ... } one array per column
+        other -> csv with a header row
+    returns 0 on success
+*/
+int export_frame_timings(struct frame_timings * ft, const char * path) {
+    FILE * f = fopen(path, "w");
+    if(f == NULL) {
+        printf("timings: could not open %s for writing\n", path);
+        return -1;
+    }
+
+    int n = ft->count;
+    size_t len = strlen(path);
+    int json = len >= 5 && !strcmp(path + len - 5, ".json");
+
+    if(json) {
+        fprintf(f, "{\n  \"frame\": [");
+        for(int i = 0; i < n; i++)
+            fprintf(f, "%s%llu", i ? "," : "", get_frame_timings(ft, i)->frame);
+        fprintf(f, "]");
+
+        for(int tag = TT_FRAME_FIRST; tag <= TT_FRAME_LAST; tag++) {
+            fprintf(f, ",\n  \"%s\": [", time_tag_name[tag]);
+            for(int i = 0; i < n; i++)
+                fprintf(f, "%s%u", i ? "," : "", get_frame_timings(ft, i)->t[tag]);
+            fprintf(f, "]");
+        }
+
+        fprintf(f, ",\n  \"Latency\": [");
+        for(int i = 0; i < n; i++)
+            fprintf(f, "%s%u", i ? "," : "", get_frame_timings(ft, i)->latency);
+        fprintf(f, "]");
+
+        fprintf(f, ",\n  \"Key Lat\": [");
+        for(int i = 0; i < n; i++)
+            fprintf(f, "%s%u", i ? "," : "", get_frame_timings(ft, i)->key_latency);
+        fprintf(f, "]");
+
+        for(int tag = 0; tag < GT_MAX; tag++) {
+            fprintf(f, ",\n  \"%s\": [", gpu_tag_name[tag]);
+            for(int i = 0; i < n; i++)
+                fprintf(f, "%s%u", i ? "," : "", get_frame_timings(ft, i)->gpu[tag]);
+            fprintf(f, "]");
+        }
+
+        fprintf(f, ",\n  \"Frame\": [");
+        for(int i = 0; i < n; i++)
+            fprintf(f, "%s%u", i ? "," : "", get_frame_timings(ft, i)->total);
+        fprintf(f, "]\n}\n");
+    } else {
+        fprintf(f, "frame");
+        for(int tag = TT_FRAME_FIRST; tag <= TT_FRAME_LAST; tag++)
+            fprintf(f, ",%s", time_tag_name[tag]);
+        fprintf(f, ",Latency,Key Lat");
+        for(int tag = 0; tag < GT_MAX; tag++)
+            fprintf(f, ",%s", gpu_tag_name[tag]);
+        fprintf(f, ",Frame\n");
+
+        for(int i = 0; i < n; i++) {
+            struct frame_sample_s * fs = get_frame_timings(ft, i);
+            fprintf(f, "%llu", fs->frame);
+            for(int tag = TT_FRAME_FIRST; tag <= TT_FRAME_LAST; tag++)
+                fprintf(f, ",%u", fs->t[tag]);
+            fprintf(f, ",%u,%u", fs->latency, fs->key_latency);
+            for(int tag = 0; tag < GT_MAX; tag++)
+                fprintf(f, ",%u", fs->gpu[tag]);
+            fprintf(f, ",%u\n", fs->total);
+        }
+    }
+
+    fclose(f);
+    printf("timings: wrote %d frames to %s\n", n, path);
+    return 0;
+}
+
+/*
+    per stage summary as one json object, no newlines:
+        {"Input":{"mean":..,"p50":..,"p99":..,"max":..}, ..., "Latency":{...}, "Key Lat":{...}, "GPU Scene":{...}, ..., "Frame":{...}}
+    used by the bench report so runs can be diffed / plotted by scripts
+*/
+void write_frame_timings_summary(FILE * f, struct frame_timings * ft) {
+    int n = ft->count;
+    unsigned int * values = malloc(sizeof(unsigned int) * (n > 0 ? n : 1));
+
+    fprintf(f, "{");
+    // stages, then latencies (presented frames only), gpu passes (measured frames only), the whole frame
+    for(int tag = TT_FRAME_FIRST; tag <= TT_FRAME_LAST + 3 + GT_MAX; tag++) {
+        int latency = tag == TT_FRAME_LAST + 1;
+        int key_latency = tag == TT_FRAME_LAST + 2;
+        int gpu = tag - (TT_FRAME_LAST + 3); // 0 .. GT_MAX - 1 -> gpu pass
+        int frame = tag == TT_FRAME_LAST + 3 + GT_MAX;
+        int stage = tag <= TT_FRAME_LAST;
+        double sum = 0.0;
+        int m = 0;
+
+        for(int i = 0; i < n; i++) {
+            struct frame_sample_s * fs = get_frame_timings(ft, i);
+            unsigned int v;
+            if(stage) v = fs->t[tag];
+            else if(latency) v = fs->latency;
+            else if(key_latency) v = fs->key_latency;
+            else if(frame) v = fs->total;
+            else v = fs->gpu[gpu];
+            if((latency || key_latency) && v == 0) continue;
+            if(!stage && !latency && !key_latency && !frame && !fs->gpu_measured) continue;
+            values[m++] = v;
+            sum += v;
+        }
+        qsort(values, m, sizeof(unsigned int), cmp_uint);
+
+        fprintf(f, "%s\"%s\":{\"mean\":%.1f,\"p50\":%u,\"p99\":%u,\"max\":%u}",
+                tag == TT_FRAME_FIRST ? "" : ",", 
+                stage ? time_tag_name[tag] : latency ? "Latency" : key_latency ? "Key Lat" : frame ? "Frame" : gpu_tag_name[gpu],
+                m ? sum / m : 0.0,
+                percentile_sorted(values, m, 50.0f),
+                percentile_sorted(values, m, 99.0f),
+                m > 0 ? values[m - 1] : 0);
+    }
+    fprintf(f, "}");
+
+    free(values);
+}
+
+#endif /* STG_TIMING_H */
@@ -0,0 +1,151 @@
+#ifndef STG_VERLET_H
+#define STG_VERLET_H
+
+#include <math.h>
+
+/*
+    verlet chains:
+        position based, the velocity is implicit in x - px
+            x' = x + (x - px) * damping
+        then the distance constraints between neighbouring points are
+        relaxed a number of iterations (more iterations -> stiffer chain)
+
+    layout:
+        same as snakes.h, point j of chain i is at [j * stride + i]
+        so every pass works on a whole row of chains at once, VERLET_LANES
+        chains per op, stride has to be a multiple of VERLET_LANES and
+        the arrays 32 byte aligned
+
+    simd:
+        AVX -> 8 chains per op, SSE -> 4, STG_VERLET_NO_SIMD forces scalar
+        all paths do the same math (no rsqrt) so results match
+*/
+#if !defined(STG_VERLET_NO_SIMD) && defined(__AVX__)
+#define STG_VERLET_AVX
+#include <immintrin.h>
+#define VERLET_LANES    8
+#elif !defined(STG_VERLET_NO_SIMD) && defined(__SSE__)
+#define STG_VERLET_SSE
+#include <xmmintrin.h>
+#define VERLET_LANES    4
+#else
+#define VERLET_LANES    1
+#endif
+
+#define VERLET_EPS      1e-6f
+
+// n points, x / px updated in place
+void verlet_integrate(float * x, float * y, float * px, float * py, int n, float damping) {
+    int i = 0;
+#if defined(STG_VERLET_AVX)
+    __m256 k = _mm256_set1_ps(damping);
+    for(; i + 8 <= n; i += 8) {
+        __m256 cx = _mm256_load_ps(x + i);
+        __m256 cy = _mm256_load_ps(y + i);
+        __m256 vx = _mm256_mul_ps(_mm256_sub_ps(cx, _mm256_load_ps(px + i)), k);
+        __m256 vy = _mm256_mul_ps(_mm256_sub_ps(cy, _mm256_load_ps(py + i)), k);
+        _mm256_store_ps(px + i, cx);
+        _mm256_store_ps(py + i, cy);
+        _mm256_store_ps(x + i, _mm256_add_ps(cx, vx));
+        _mm256_store_ps(y + i, _mm256_add_ps(cy, vy));
+    }
+#elif defined(STG_VERLET_SSE)
+    __m128 k = _mm_set1_ps(damping);
+    for(; i + 4 <= n; i += 4) {
+        __m128 cx = _mm_load_ps(x + i);
+        __m128 cy = _mm_load_ps(y + i);
+        __m128 vx = _mm_mul_ps(_mm_sub_ps(cx, _mm_load_ps(px + i)), k);
+        __m128 vy = _mm_mul_ps(_mm_sub_ps(cy, _mm_load_ps(py + i)), k);
+        _mm_store_ps(px + i, cx);
+        _mm_store_ps(py + i, cy);
+        _mm_store_ps(x + i, _mm_add_ps(cx, vx));
+        _mm_store_ps(y + i, _mm_add_ps(cy, vy));
+    }
+#endif
+    for(; i < n; i++) {
+        float vx = (x[i] - px[i]) * damping;
+        float vy = (y[i] - py[i]) * damping;
+        px[i] = x[i];
+        py[i] = y[i];
+        x[i] += vx;
+        y[i] += vy;
+    }
+}
+
+/*
+    one relaxation pass over the link between row a and row b (lanes chains)
+    wa / wb are the share of the correction each side takes (pinned side -> 0)
+*/
+static inline void verlet_relax_row(float * ax, float * ay, float * bx, float * by, int lanes,
+                                    float rest, float wa, float wb) {
+    int i = 0;
+#if defined(STG_VERLET_AVX)
+    __m256 r = _mm256_set1_ps(rest);
+    __m256 eps = _mm256_set1_ps(VERLET_EPS);
+    __m256 va = _mm256_set1_ps(wa);
+    __m256 vb = _mm256_set1_ps(wb);
+    for(; i + 8 <= lanes; i += 8) {
+        __m256 x0 = _mm256_load_ps(ax + i), y0 = _mm256_load_ps(ay + i);
+        __m256 x1 = _mm256_load_ps(bx + i), y1 = _mm256_load_ps(by + i);
+        __m256 dx = _mm256_sub_ps(x1, x0);
+        __m256 dy = _mm256_sub_ps(y1, y0);
+        __m256 d = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+        __m256 k = _mm256_div_ps(_mm256_sub_ps(d, r), _mm256_max_ps(d, eps));
+        dx = _mm256_mul_ps(dx, k);
+        dy = _mm256_mul_ps(dy, k);
+        _mm256_store_ps(ax + i, _mm256_add_ps(x0, _mm256_mul_ps(dx, va)));
+        _mm256_store_ps(ay + i, _mm256_add_ps(y0, _mm256_mul_ps(dy, va)));
+        _mm256_store_ps(bx + i, _mm256_sub_ps(x1, _mm256_mul_ps(dx, vb)));
+        _mm256_store_ps(by + i, _mm256_sub_ps(y1, _mm256_mul_ps(dy, vb)));
+    }
+#elif defined(STG_VERLET_SSE)
+    __m128 r = _mm_set1_ps(rest);
+    __m128 eps = _mm_set1_ps(VERLET_EPS);
+    __m128 va = _mm_set1_ps(wa);
+    __m128 vb = _mm_set1_ps(wb);
+    for(; i + 4 <= lanes; i += 4) {
+        __m128 x0 = _mm_load_ps(ax + i), y0 = _mm_load_ps(ay + i);
+        __m128 x1 = _mm_load_ps(bx + i), y1 = _mm_load_ps(by + i);
+        __m128 dx = _mm_sub_ps(x1, x0);
+        __m128 dy = _mm_sub_ps(y1, y0);
+        __m128 d = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+        __m128 k = _mm_div_ps(_mm_sub_ps(d, r), _mm_max_ps(d, eps));
+        dx = _mm_mul_ps(dx, k);
+        dy = _mm_mul_ps(dy, k);
+        _mm_store_ps(ax + i, _mm_add_ps(x0, _mm_mul_ps(dx, va)));
+        _mm_store_ps(ay + i, _mm_add_ps(y0, _mm_mul_ps(dy, va)));
+        _mm_store_ps(bx + i, _mm_sub_ps(x1, _mm_mul_ps(dx, vb)));
+        _mm_store_ps(by + i, _mm_sub_ps(y1, _mm_mul_ps(dy, vb)));
+    }
+#endif
+    for(; i < lanes; i++) {
+        float dx = bx[i] - ax[i];
+        float dy = by[i] - ay[i];
+        float d = sqrtf(dx * dx + dy * dy);
+        float k = (d - rest) / (d > VERLET_EPS ? d : VERLET_EPS);
+        dx *= k;
+        dy *= k;
+        ax[i] += dx * wa;
+        ay[i] += dy * wa;
+        bx[i] -= dx * wb;
+        by[i] -= dy * wb;
+    }
+}
+
+/*
+    distance constraints along `lanes` chains of `points` points, rest apart
+    pin_first -> point 0 is driven from outside (snake head) and never moved
+*/
+void verlet_relax_chains(float * x, float * y, int stride, int lanes, int points,
+                            float rest, int iterations, int pin_first) {
+    for(int it = 0; it < iterations; it++) {
+        for(int j = 1; j < points; j++) {
+            int pinned = pin_first && j == 1;
+            verlet_relax_row(x + (j - 1) * stride, y + (j - 1) * stride,
+                             x + j * stride, y + j * stride, lanes,
+                             rest, pinned ? 0.0f : 0.5f, pinned ? 1.0f : 0.5f);
+        }
+    }
+}
+
+#endif /* STG_VERLET_H */